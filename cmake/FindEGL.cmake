@@ -0,0 +1,40 @@
+
+# EGL_FOUND
+# EGL_INCLUDE_DIR
+# EGL_LIBRARY
+
+include(FindPackageHandleStandardArgs)
+
+find_path(EGL_INCLUDE_DIR EGL/egl.h
+
+    PATHS
+    $ENV{EGL_DIR}
+    /usr
+    /usr/local
+    /sw
+    /opt/local
+
+    PATH_SUFFIXES
+    /include
+
+    DOC "The directory where EGL/egl.h resides")
+
+find_library(EGL_LIBRARY NAMES EGL libEGL
+
+    PATHS
+    $ENV{EGL_DIR}
+    /usr
+    /usr/local
+    /sw
+    /opt/local
+
+    PATH_SUFFIXES
+    /lib
+    /lib64
+    /lib/x86_64-linux-gnu
+
+    DOC "The EGL library")
+
+find_package_handle_standard_args(EGL REQUIRED_VARS EGL_LIBRARY EGL_INCLUDE_DIR)
+
+mark_as_advanced(EGL_INCLUDE_DIR EGL_LIBRARY)
@@ -0,0 +1,48 @@
+#version 150 core
+
+// Upsamples the smoothed fluid depth from fluid to window resolution and reconstructs
+// the fluid surface. The upsampling is edge-aware: of the four bilinear taps, only those
+// of similar depth as the nearest tap contribute, thus silhouettes are neither blurred
+// into the background nor dilated.
+
+uniform sampler2D source;
+uniform mat4 ndcInverse;
+
+const float depthThreshold = 0.002; // in window depth
+
+in vec2 v_uv;
+
+out vec4 out_color;
+
+
+void main()
+{
+	ivec2 size = textureSize(source, 0);
+
+	vec2 st = v_uv * vec2(size) - 0.5;
+	ivec2 base = ivec2(floor(st));
+	vec2 f = st - vec2(base);
+
+	vec4 d = vec4(
+		texelFetch(source, clamp(base + ivec2(0, 0), ivec2(0), size - 1), 0).r,
+		texelFetch(source, clamp(base + ivec2(1, 0), ivec2(0), size - 1), 0).r,
+		texelFetch(source, clamp(base + ivec2(0, 1), ivec2(0), size - 1), 0).r,
+		texelFetch(source, clamp(base + ivec2(1, 1), ivec2(0), size - 1), 0).r);
+
+	vec4 w = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+	// the nearest tap decides between fluid and background
+	float reference = f.y < 0.5 ? (f.x < 0.5 ? d.x : d.y) : (f.x < 0.5 ? d.z : d.w);
+	if(reference >= 1.0)
+		discard;
+
+	w *= vec4(lessThan(abs(d - reference), vec4(depthThreshold)));
+	float weight = dot(w, vec4(1.0));
+
+	float depth = weight > 0.0 ? dot(d, w) / weight : reference;
+
+	vec2 uv = (v_uv - 0.5) * 2.0;
+	vec4 pos = ndcInverse * vec4(uv, depth, 1.0);
+
+	out_color = vec4(pos.xyz, 0.0);
+}
@@ -1,52 +1,50 @@
 #version 150 core
 
+// One direction of the separable, bilateral smoothing of the particle depth at fluid
+// resolution; see fluid-smooth.comp for the shared memory variant and
+// fluid-composite.frag for the reconstruction at window resolution.
+
 uniform sampler2D source;
-uniform vec2 advance;
-uniform mat4 ndcInverse;
+uniform vec2 advance; // (1, 0) for the horizontal, (0, 1) for the vertical pass
+uniform int radius;   // in texels
 
 in vec2 v_uv;
 
-out vec4 out_color;
+out float out_depth;
 
-const int kernelSize = 100;
+const float depthThreshold = 0.002; // in window depth, taps beyond do not contribute
 
 
 void main()
 {
-	float sum = texture(source, v_uv).r;
-	if(sum >= 1.0)
-		discard;
+	ivec2 size = textureSize(source, 0);
+	ivec2 center = ivec2(v_uv * vec2(size));
+	ivec2 direction = ivec2(advance);
 
-	int kernelHalfSize = (kernelSize - 1) / 2;
-
-	vec2 texelOffset = 1.0 / vec2(textureSize(source, 0));
+	float depth = texelFetch(source, center, 0).r;
+	if(depth >= 1.0)
+		discard;
 
-	for(int i = -kernelHalfSize; i < 0; ++i)
-		sum += texture(source, v_uv + i * advance * texelOffset).r;
-	for(int i = 1; i <= kernelHalfSize; ++i)
-		sum += texture(source, v_uv + i * advance * texelOffset).r;
+	// the taps are independent of each other, i.e., there is no dependent fetch
+	float spatial = -0.5 / max(float(radius * radius) * 0.25, 1.0);
+	float range = -0.5 / (depthThreshold * depthThreshold * 0.25);
 
-	sum /= float(kernelSize);
+	float sum = depth;
+	float weight = 1.0;
 
-	if(advance.x > 0.0)
+	for(int i = -radius; i <= radius; ++i)
 	{
-		//out_color = vec4(uv, sum.a, 0.0);
-	}
-	else
-	{
-		// retrieve normals
+		if(i == 0)
+			continue;
 
-		//
-	}
+		float d = texelFetch(source, clamp(center + i * direction, ivec2(0), size - 1), 0).r;
+		float delta = d - depth;
 
-    
-    vec2 uv = (v_uv - 0.5) * 2.0;
-    vec4 pos = vec4(uv, sum, 1.0);
+		float w = exp(float(i * i) * spatial + delta * delta * range) * float(abs(delta) < depthThreshold);
 
-    pos = ndcInverse * pos;
-    
-    //out_color = vec4(uv, sum.a, 0.0);
+		sum += d * w;
+		weight += w;
+	}
 
-    out_color = vec4(pos.xyz, 0.0);
-    //out_color = vec4(sum.xyz, 0.0);
+	out_depth = sum / weight;
 }
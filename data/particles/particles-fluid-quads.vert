@@ -0,0 +1,50 @@
+#version 330 core
+
+// Expands each particle into a view aligned quad of two triangles without a geometry
+// shader (see particles-fluid.geom): vertex i belongs to particle i / 6, whose position
+// is pulled from the particle buffer via a buffer texture.
+
+uniform samplerBuffer positions;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 ndcInverse;
+
+uniform vec4 scale; // 1.0 / width, 1.0 / height, radius, aspect ratio
+
+out vec2 g_uv;
+out vec4 g_pos;
+out float g_radius;
+
+const vec2 corners[6] = vec2[6](
+	vec2(-1.0, -1.0), vec2(-1.0,  1.0), vec2( 1.0, -1.0),
+	vec2( 1.0, -1.0), vec2(-1.0,  1.0), vec2( 1.0,  1.0));
+
+void main()
+{
+	vec4 p = vec4(texelFetch(positions, gl_VertexID / 6).xyz, 1.0);
+
+	// frustum culling: all six vertices collapse outside the clip volume
+	vec4 pndc = projection * view * p;
+
+	vec2 c = clamp(abs(pndc.xy) / pndc.w, 0.0, 1.0);
+	if(any(equal(c, vec2(1.0))))
+	{
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+
+	float radius = scale[2];
+
+	g_pos = view * p;
+
+	// create the front-most point
+	vec4 fmp = view * (p + vec4(0.0, 0.0, radius, 0.0));
+	// retrieve radius in view space
+	g_radius = length(fmp - g_pos);
+
+	vec2 corner = corners[gl_VertexID % 6];
+	g_uv = corner;
+
+	gl_Position = projection * view * (p + radius * (ndcInverse * vec4(corner.x, corner.y * scale[3], 0.0, 0.0)));
+}
@@ -0,0 +1,46 @@
+#version 330 core
+
+// Expands each particle into a quad of two triangles without a geometry shader (see
+// particles.geom): vertex i belongs to particle i / 6, whose position is pulled from the
+// particle buffer via a buffer texture. With SORTED, particle i / 6 is looked up in the
+// order given by the sort (see particles-sort.comp) instead.
+
+uniform samplerBuffer positions;
+#ifdef SORTED
+uniform usamplerBuffer order;
+#endif
+uniform vec3 scale; // 1.0 / width, 1.0 / height, radius
+uniform mat4 transform;
+
+out vec2 g_uv;
+out vec4 g_color;
+
+const vec2 corners[6] = vec2[6](
+	vec2(-1.0, -1.0), vec2(-1.0,  1.0), vec2( 1.0, -1.0),
+	vec2( 1.0, -1.0), vec2(-1.0,  1.0), vec2( 1.0,  1.0));
+
+void main()
+{
+#ifdef SORTED
+	int index = int(texelFetch(order, gl_VertexID / 6).r);
+#else
+	int index = gl_VertexID / 6;
+#endif
+	vec4 vertex = texelFetch(positions, index);
+	vec4 p = transform * vec4(vertex.xyz, 1.0);
+
+	// frustum culling: all six vertices collapse outside the clip volume
+	vec2 c = clamp(abs(p.xy) / p.w, 0.0, 1.0);
+	if(any(equal(c, vec2(1.0))))
+	{
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+
+	vec2 corner = corners[gl_VertexID % 6];
+
+	g_uv = corner;
+	g_color = vec4(vertex.xyz * 0.5 + 0.5, clamp(vertex.y * 8.0, 0.0, 1.0));
+
+	gl_Position = p + vec4(corner * scale.xy * scale[2], 0.0, 0.0);
+}
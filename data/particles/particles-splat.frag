@@ -0,0 +1,49 @@
+#version 430
+
+// Resolves the splat buffer written by particles-splat.comp into color and depth.
+
+#ifdef INT64_ATOMICS
+#extension GL_ARB_gpu_shader_int64 : require
+#endif
+
+uniform ivec2 size;
+
+layout (std430, binding = 2) readonly buffer Splats
+{
+#ifdef INT64_ATOMICS
+    uint64_t splats[];
+#else
+    uint splats[];
+#endif
+};
+
+out vec4 out_color;
+
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	uint index = uint(pixel.y * size.x + pixel.x);
+
+#ifdef INT64_ATOMICS
+	uvec2 splat = unpackUint2x32(splats[index]);
+	if(splat.y == 0xFFFFFFFFu)
+		discard;
+
+	float depth = uintBitsToFloat(splat.y);
+	vec4 color = unpackUnorm4x8(splat.x);
+
+	out_color = vec4(mix(vec3(1.0), color.rgb, color.a), 1.0);
+#else
+	uint splat = splats[index];
+	if(splat == 0xFFFFFFFFu)
+		discard;
+
+	// without payload, shade by depth
+	float depth = uintBitsToFloat(splat);
+
+	out_color = vec4(vec3(pow(depth, 64.0)), 1.0);
+#endif
+
+	gl_FragDepth = depth;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+// Soft, translucent discs; drawn back to front with blending and without depth writes.
+
+in vec2 g_uv;
+in vec4 g_color;
+
+out vec4 out_color;
+
+const float opacity = 0.5;
+
+void main()
+{
+	vec2 uv = g_uv;
+
+	float v = dot(uv, uv);
+	if(v > 1.0)
+		discard;
+
+	out_color = vec4(mix(vec3(1.0), g_color.xyz, g_color.w), opacity * (1.0 - v));
+}
@@ -0,0 +1,58 @@
+#version 450 core
+
+// Counts the 2x2 quads launched by the rasterizer and the helper invocations
+// within them (lanes that are shaded for derivatives only, e.g., along the
+// diagonal seam of a two triangle quad). Helper invocations cannot write to
+// atomic counters, thus the first live lane of each quad reconstructs the
+// helper state of its neighbors via fine derivatives and accounts for them.
+
+layout(binding = 0, offset = 0) uniform atomic_uint fragments;
+layout(binding = 0, offset = 4) uniform atomic_uint quads;
+layout(binding = 0, offset = 8) uniform atomic_uint helpers;
+
+out float out_color;
+
+void main()
+{
+	// all lanes of the quad, including helpers, take part in these derivatives
+	float h = float(gl_HelperInvocation);
+
+	float dx = dFdxFine(h);  // h(1, y) - h(0, y) of this lane's row
+	float dy = dFdyFine(h);  // h(x, 1) - h(x, 0) of this lane's column
+	float dxy = dFdyFine(dx); // dx of upper row - dx of lower row
+
+	out_color = 0.0;
+
+	if(gl_HelperInvocation)
+		return;
+
+	ivec2 lane = ivec2(gl_FragCoord.xy) & 1;
+
+	float dxOther = dx + (lane.y == 0 ? dxy : -dxy);
+
+	float hx  = lane.x == 0 ? h + dx : h - dx; // horizontal neighbor
+	float hy  = lane.y == 0 ? h + dy : h - dy; // vertical neighbor
+	float hxy = lane.x == 0 ? hy + dxOther : hy - dxOther; // diagonal neighbor
+
+	// helper state of lanes (0, 0), (1, 0), (0, 1), and (1, 1)
+	vec4 quad;
+	quad[lane.x + 2 * lane.y] = h;
+	quad[(1 - lane.x) + 2 * lane.y] = hx;
+	quad[lane.x + 2 * (1 - lane.y)] = hy;
+	quad[(1 - lane.x) + 2 * (1 - lane.y)] = hxy;
+	quad = round(quad);
+
+	atomicCounterIncrement(fragments);
+
+	// the first live lane of the quad accounts for the quad and its helpers
+	int index = lane.x + 2 * lane.y;
+	for(int i = 0; i < index; ++i)
+		if(quad[i] < 0.5)
+			return;
+
+	atomicCounterIncrement(quads);
+
+	uint numHelpers = uint(dot(quad, vec4(1.0)));
+	for(uint i = 0u; i < numHelpers; ++i)
+		atomicCounterIncrement(helpers);
+}
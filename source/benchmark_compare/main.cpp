@@ -0,0 +1,173 @@
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cgutils/arguments.h>
+#include <cgutils/benchmark.h>
+
+
+// From http://en.cppreference.com/w/cpp/language/namespace:
+// "Unnamed namespace definition. Its members have potential scope
+// from their point of declaration to the end of the translation
+// unit, and have internal linkage."
+namespace
+{
+
+// fields that identify a run rather than its configuration
+const char * const runKeys[] = { "revision", "timestamp", "frames", "warmup" };
+
+// Results are comparable if all fields but the run specific ones match,
+// including the host fingerprint; measured metrics are not fields.
+std::string configuration(const cgutils::BenchmarkResult & result)
+{
+    auto key = std::string();
+    for (const auto & field : result.fields())
+    {
+        if (std::find(std::begin(runKeys), std::end(runKeys), field.first) != std::end(runKeys))
+            continue;
+
+        key += (key.empty() ? "" : " ") + field.first + "=" + result.get(field.first);
+    }
+    return key;
+}
+
+double median(std::vector<std::uint64_t> samples)
+{
+    if (samples.empty())
+        return 0.0;
+
+    std::sort(samples.begin(), samples.end());
+
+    const auto n = samples.size();
+    return n % 2 ? static_cast<double>(samples[n / 2]) : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+}
+
+// Median frame time of each run; the frames of a run are autocorrelated and thus are
+// not independent samples, the runs are.
+struct Runs
+{
+    std::vector<std::uint64_t> baseline;
+    std::vector<std::uint64_t> candidate;
+};
+
+}
+
+
+int main(int argc, char ** argv)
+{
+    // [--store <file>] results store to read (benchmarks.jsonl by default),
+    // [--baseline <revision>] and [--candidate <revision>] revisions to compare (the last
+    // two revisions in the store by default), [--alpha <p>] significance level,
+    // [--threshold <r>] minimum relative change of the median to be reported,
+    // [--min-runs <n>] runs per revision a configuration is compared from
+    const auto arguments = cgutils::Arguments(argc, argv);
+
+    const auto store = arguments.value("store", "benchmarks.jsonl");
+    const auto alpha = arguments.value("alpha", 0.05f);
+    const auto threshold = arguments.value("threshold", 0.02f);
+    const auto minimumRuns = std::max(2, arguments.value("min-runs", 5));
+
+    const auto results = cgutils::loadBenchmarkResults(store);
+    if (results.empty())
+    {
+        std::cerr << "No results in '" << store << "'." << std::endl;
+        return 2;
+    }
+
+    // revisions in order of their first appearance in the store
+    auto revisions = std::vector<std::string>();
+    for (const auto & result : results)
+    {
+        const auto revision = result.get("revision");
+        if (std::find(revisions.begin(), revisions.end(), revision) == revisions.end())
+            revisions.push_back(revision);
+    }
+
+    const auto candidate = arguments.value("candidate", revisions.back());
+    auto baseline = arguments.value("baseline", "");
+    if (baseline.empty())
+    {
+        for (auto it = revisions.rbegin(); it != revisions.rend() && baseline.empty(); ++it)
+            if (*it != candidate)
+                baseline = *it;
+    }
+
+    if (baseline.empty() || baseline == candidate)
+    {
+        std::cerr << "No baseline revision to compare " << candidate << " against." << std::endl;
+        return 2;
+    }
+
+    // repeated runs of the same configuration and revision are the samples
+    auto runs = std::map<std::string, Runs>();
+    for (const auto & result : results)
+    {
+        const auto revision = result.get("revision");
+        if ((revision != baseline && revision != candidate) || result.samples().empty())
+            continue;
+
+        auto & entry = runs[configuration(result)];
+        (revision == baseline ? entry.baseline : entry.candidate).push_back(static_cast<std::uint64_t>(result.median()));
+    }
+
+    std::cout << "Comparing " << candidate << " against " << baseline << " (alpha " << alpha
+        << ", threshold " << threshold * 100.f << "%, at least " << minimumRuns << " runs each)" << std::endl << std::endl;
+
+    std::cout << "status,change_percent,p,baseline_median_ns,candidate_median_ns,baseline_runs,candidate_runs,configuration" << std::endl;
+
+    auto compared = 0;
+    auto regressions = 0;
+    for (const auto & entry : runs)
+    {
+        const auto & sides = entry.second;
+        if (sides.baseline.empty() || sides.candidate.empty())
+            continue;
+
+        const auto baselineMedian = median(sides.baseline);
+        const auto candidateMedian = median(sides.candidate);
+        const auto change = baselineMedian > 0.0 ? candidateMedian / baselineMedian - 1.0 : 0.0;
+
+        const auto sufficient = static_cast<int>(std::min(sides.baseline.size(), sides.candidate.size())) >= minimumRuns;
+        if (!sufficient)
+        {
+            std::cout << "too few runs," << std::fixed << std::setprecision(2) << change * 100.0 << ",,"
+                << std::setprecision(0) << baselineMedian << "," << candidateMedian << ","
+                << sides.baseline.size() << "," << sides.candidate.size() << ","
+                << "\"" << entry.first << "\"" << std::endl;
+            continue;
+        }
+        ++compared;
+
+        const auto test = cgutils::mannWhitneyU(sides.baseline, sides.candidate);
+
+        auto status = "same";
+        if (test.p < alpha && change > threshold)
+        {
+            status = "regression";
+            ++regressions;
+        }
+        else if (test.p < alpha && change < -threshold)
+            status = "improvement";
+
+        std::cout << status << "," << std::fixed << std::setprecision(2) << change * 100.0 << ","
+            << std::scientific << std::setprecision(3) << test.p << ","
+            << std::fixed << std::setprecision(0) << baselineMedian << "," << candidateMedian << ","
+            << sides.baseline.size() << "," << sides.candidate.size() << ","
+            << "\"" << entry.first << "\"" << std::endl;
+    }
+
+    std::cout << std::endl << regressions << " significant regression(s) in " << compared << " compared configuration(s)" << std::endl;
+
+    // nothing compared is no evidence against a regression
+    if (compared == 0)
+    {
+        std::cerr << "No configuration with at least " << minimumRuns << " runs of both revisions." << std::endl;
+        return 2;
+    }
+
+    return regressions > 0 ? 1 : 0;
+}
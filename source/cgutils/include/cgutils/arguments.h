@@ -0,0 +1,34 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <cgutils/cgutils_api.h>
+
+
+namespace cgutils
+{
+
+// Command line and config file options of the form "--key value", "--key=value", or
+// "--flag". A config file given by "--config <file>" contains "key = value" lines 
+// ('#' starts a comment); options on the command line take precedence.
+class CGUTILS_API Arguments
+{
+public:
+    Arguments(int argc, const char * const * argv);
+
+    bool loadConfig(const char * filePath);
+
+    bool has(const std::string & key) const;
+
+    std::string value(const std::string & key, const std::string & defaultValue) const;
+    std::string value(const std::string & key, const char * defaultValue) const;
+    int value(const std::string & key, int defaultValue) const;
+    float value(const std::string & key, float defaultValue) const;
+    bool value(const std::string & key, bool defaultValue) const;
+
+protected:
+    std::map<std::string, std::string> m_values;
+};
+
+} // namespace cgutils
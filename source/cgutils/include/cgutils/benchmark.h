@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cgutils/cgutils_api.h>
+
+
+namespace cgutils
+{
+
+// Benchmark configuration, measured metrics, and timing samples (in nanoseconds) of a 
+// single run, serialized as JSON object with the fields in order of insertion, the 
+// metrics as nested object, and summary statistics of the samples.
+class CGUTILS_API BenchmarkResult
+{
+public:
+    void set(const std::string & key, const std::string & value);
+    void set(const std::string & key, const char * value);
+    void set(const std::string & key, double value);
+    void set(const std::string & key, std::int64_t value);
+    void set(const std::string & key, int value);
+    void set(const std::string & key, bool value);
+
+    // Adds git revision, UTC timestamp, and host fingerprint (host name, cpu model,
+    // hardware threads, os) to identify where and from which sources a result stems.
+    void setEnvironment();
+
+    bool has(const std::string & key) const;
+    // Returns the field's value, unquoted for strings, or an empty string.
+    std::string get(const std::string & key) const;
+    const std::vector<std::pair<std::string, std::string>> & fields() const;
+
+    // Values measured during the run besides the frame times (e.g., counters or pass
+    // times); unlike fields, they do not identify the configuration.
+    void setMetric(const std::string & key, double value);
+    std::string metric(const std::string & key) const;
+    const std::vector<std::pair<std::string, std::string>> & metrics() const;
+
+    void addSample(std::uint64_t nanoseconds);
+    const std::vector<std::uint64_t> & samples() const;
+
+    double mean() const;
+    double median() const;
+    double stddev() const;
+
+    std::string toJson() const;
+
+    // Parses a single JSON object as written by toJson(); summary statistics are
+    // not read but recomputed from the samples.
+    static bool fromJson(const std::string & json, BenchmarkResult & result);
+
+    // Writes the JSON object to the given file or to stdout for an empty path or "-".
+    bool write(const std::string & filePath) const;
+    // Appends the JSON object as single line to the given results store (JSON lines).
+    bool append(const std::string & filePath) const;
+
+protected:
+    void setEncoded(const std::string & key, const std::string & encoded);
+
+protected:
+    std::vector<std::pair<std::string, std::string>> m_fields; // key and JSON encoded value
+    std::vector<std::pair<std::string, std::string>> m_metrics; // likewise
+    std::vector<std::uint64_t> m_samples;
+};
+
+// Reads all results of a store written by BenchmarkResult::append, skipping malformed lines.
+CGUTILS_API std::vector<BenchmarkResult> loadBenchmarkResults(const std::string & filePath);
+
+CGUTILS_API std::string jsonEscaped(const std::string & text);
+
+
+// Two-sided Mann-Whitney U test (normal approximation with tie correction): p is the 
+// probability of observing such a rank difference if both sample sets stem from the 
+// same distribution. No assumption about the distribution (e.g., normality) is made,
+// which suits frame times with their long tails.
+struct MannWhitneyU
+{
+    double u; // U statistic of the first sample set
+    double z;
+    double p;
+};
+
+CGUTILS_API MannWhitneyU mannWhitneyU(const std::vector<std::uint64_t> & a, const std::vector<std::uint64_t> & b);
+
+// Invokes frame() for warmup plus measured frames and adds the wall time of each
+// measured frame as sample; frame() should synchronize (e.g., glFinish) for GPU work.
+CGUTILS_API void measureFrames(BenchmarkResult & result, int frames, int warmup, const std::function<void()> & frame);
+
+} // namespace cgutils
@@ -25,6 +25,11 @@ CGUTILS_API std::vector<char> rawFromFile(const char * filePath);
 
 CGUTILS_API std::string textFromFile(const char * filePath);
 
+// Inserts a #define for each of the given defines, e.g., "INT64_ATOMICS" or "GROUP_SIZE 256",
+// right after the #version directive of a shader source, followed by a #line directive that
+// keeps line numbers in compiler messages referring to the original source.
+CGUTILS_API std::string injectDefines(const std::string & source, const std::vector<std::string> & defines);
+
 CGUTILS_API bool createShader(gl::GLenum type, const std::string & name, const std::string & source, gl::GLuint & id);
 CGUTILS_API bool createProgram(const std::string & name, gl::GLuint vertexShader, gl::GLuint fragmentShader, gl::GLuint & id);
 
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cgutils/cgutils_api.h>
+
+
+namespace cgutils
+{
+
+// OpenGL context without a window or display server (e.g., for build and perf machines).
+// Uses EGL (surfaceless Mesa platform if available, default display otherwise) and 
+// renders into a pbuffer surface of the given size, i.e., the default framebuffer 
+// behaves as with a window. For a software rasterizer stand-in run with Mesa's 
+// llvmpipe, e.g., LIBGL_ALWAYS_SOFTWARE=1.
+class CGUTILS_API HeadlessContext
+{
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    // Returns false if no context could be created or cgutils was built without EGL.
+    bool create(int width, int height, int majorVersion, int minorVersion);
+    void destroy();
+
+    void makeCurrent();
+    void doneCurrent();
+    void swapBuffers();
+
+    bool valid() const;
+
+protected:
+    void * m_display;
+    void * m_surface;
+    void * m_context;
+};
+
+} // namespace cgutils
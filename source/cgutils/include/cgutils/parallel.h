@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <cgutils/cgutils_api.h>
+
+
+namespace cgutils
+{
+
+// Multi-threaded primitives on contiguous arrays. Each thread works on one contiguous range
+// of equal size; threads is the number of threads to use at most (hardware concurrency for 0),
+// fewer are used for small inputs as starting threads would cost more than they save.
+
+// Sorts keys in ascending order by a least significant digit radix sort of 8-bit digits;
+// the sort is stable and passes in which all keys share the digit are skipped. If values is
+// not null, it is permuted along with the keys, e.g., to sort indices by key. Allocates a
+// temporary copy of keys and values.
+CGUTILS_API void radixSort(std::uint32_t * keys, std::uint32_t * values, std::size_t count, unsigned int threads = 0);
+CGUTILS_API void radixSort(std::uint64_t * keys, std::uint32_t * values, std::size_t count, unsigned int threads = 0);
+
+// Writes the sum of all preceding elements for each element (output may equal input) and
+// returns the sum of all elements; the output wraps around beyond 2^32 - 1.
+CGUTILS_API std::uint64_t exclusiveScan(const std::uint32_t * input, std::uint32_t * output, std::size_t count, unsigned int threads = 0);
+
+// Writes the indices of the nonzero flags in ascending order and returns their number;
+// indices needs to hold count indices at most.
+CGUTILS_API std::size_t compactIndices(const std::uint8_t * flags, std::uint32_t * indices, std::size_t count, unsigned int threads = 0);
+
+// Counts the occurrences of each bin index below numBins into bins (values not below numBins
+// are ignored); bins is overwritten.
+CGUTILS_API void histogram(const std::uint32_t * values, std::size_t count, std::uint32_t * bins, std::size_t numBins, unsigned int threads = 0);
+
+} // namespace cgutils
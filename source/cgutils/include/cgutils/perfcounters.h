@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <cgutils/cgutils_api.h>
+
+
+namespace cgutils
+{
+
+// Hardware performance counters of the calling process via perf_event_open (Linux only).
+// Counters are inherited by threads created after open(), thus open them before any
+// thread pool (e.g., OpenMP) is started to include its worker threads. If counters are
+// not permitted (e.g., perf_event_paranoid, containers) or not supported by the host,
+// the respective events are unavailable and read zero.
+class CGUTILS_API PerfCounters
+{
+public:
+    enum class Event
+    {
+        Cycles,
+        Instructions,
+        LLCMisses,
+        DTLBMisses,
+        BranchMisses
+    };
+
+    static const int numEvents = 5;
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters & operator=(const PerfCounters &) = delete;
+
+    // Returns true if at least one event could be opened.
+    bool open();
+    void close();
+
+    bool available() const;
+    bool available(Event event) const;
+
+    // Counts events between start and stop, accumulated over all start/stop pairs since reset.
+    void start();
+    void stop();
+    void reset();
+
+    // Accumulated count, extrapolated if the event was multiplexed with others.
+    std::uint64_t value(Event event) const;
+
+    static const char * name(Event event);
+
+protected:
+    std::array<int, numEvents> m_fds;
+    std::array<std::uint64_t, numEvents> m_values;
+    bool m_running;
+};
+
+} // namespace cgutils
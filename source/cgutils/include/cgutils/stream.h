@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+#include <cgutils/cgutils_api.h>
+
+
+namespace cgutils
+{
+
+// Sustainable memory bandwidth in bytes per second, measured STREAM-style
+// (https://www.cs.virginia.edu/stream/) as best of several repetitions.
+struct StreamBandwidth
+{
+    unsigned int threads;
+    double copy;  // c[i] = a[i], 16 byte per element
+    double triad; // a[i] = b[i] + s * c[i], 24 byte per element
+};
+
+struct StreamResult
+{
+    StreamBandwidth single;
+    StreamBandwidth all;
+};
+
+// Measures with the given number of threads (hardware concurrency for 0) on three arrays
+// of doubles; the default size of 3 x 128 MiB exceeds the last level caches of common hosts.
+CGUTILS_API StreamBandwidth measureStreamBandwidth(unsigned int threads = 0, std::size_t elements = std::size_t{ 1 } << 24, int repetitions = 10);
+
+// Measures single-threaded and with all hardware threads.
+CGUTILS_API StreamResult measureStream(std::size_t elements = std::size_t{ 1 } << 24, int repetitions = 10);
+
+} // namespace cgutils
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <cgutils/cgutils_api.h>
+
+
+namespace cgutils
+{
+
+// Model name of the (first) CPU, e.g., as listed in /proc/cpuinfo, or "unknown".
+CGUTILS_API std::string cpuModel();
+
+// Logical CPUs available to the process grouped by physical core, i.e., SMT siblings
+// share a group. Read from sysfs on Linux; elsewhere each hardware thread is reported
+// as a core of its own (CPU numbers are then only meaningful as count).
+CGUTILS_API std::vector<std::vector<int>> cpuCores();
+
+// Restricts the calling thread to the given logical CPU (Linux only, false otherwise).
+CGUTILS_API bool pinCurrentThread(int cpu);
+
+// Allows the calling thread to run on all logical CPUs available to the process again.
+CGUTILS_API bool unpinCurrentThread();
+
+} // namespace cgutils
@@ -0,0 +1,122 @@
+
+#include <cgutils/arguments.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+
+namespace
+{
+
+std::string trimmed(const std::string & text)
+{
+    const auto first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+        return std::string();
+
+    const auto last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+}
+
+
+namespace cgutils
+{
+
+Arguments::Arguments(const int argc, const char * const * argv)
+{
+    for (auto i = 1; i < argc; ++i)
+    {
+        const auto argument = std::string(argv[i]);
+        if (argument.compare(0, 2, "--") != 0)
+        {
+            std::cerr << "Ignoring argument '" << argument << "' (expected --key [value])." << std::endl;
+            continue;
+        }
+
+        const auto assignment = argument.find('=');
+        if (assignment != std::string::npos)
+        {
+            m_values[argument.substr(2, assignment - 2)] = argument.substr(assignment + 1);
+            continue;
+        }
+
+        // a key followed by another key is a flag
+        const auto key = argument.substr(2);
+        if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+            m_values[key] = argv[++i];
+        else
+            m_values[key] = "true";
+    }
+
+    if (has("config"))
+        loadConfig(m_values["config"].c_str());
+}
+
+bool Arguments::loadConfig(const char * filePath)
+{
+    auto stream = std::ifstream(filePath);
+    if (!stream)
+    {
+        std::cerr << "Reading config file '" << filePath << "' failed." << std::endl;
+        return false;
+    }
+
+    auto line = std::string();
+    while (std::getline(stream, line))
+    {
+        line = trimmed(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        const auto assignment = line.find('=');
+        const auto key = trimmed(line.substr(0, assignment));
+        const auto value = assignment != std::string::npos ? trimmed(line.substr(assignment + 1)) : std::string("true");
+
+        // command line arguments take precedence
+        m_values.insert(std::make_pair(key, value));
+    }
+
+    return true;
+}
+
+bool Arguments::has(const std::string & key) const
+{
+    return m_values.find(key) != m_values.end();
+}
+
+std::string Arguments::value(const std::string & key, const std::string & defaultValue) const
+{
+    const auto it = m_values.find(key);
+    return it != m_values.end() ? it->second : defaultValue;
+}
+
+std::string Arguments::value(const std::string & key, const char * defaultValue) const
+{
+    return value(key, std::string(defaultValue));
+}
+
+int Arguments::value(const std::string & key, const int defaultValue) const
+{
+    const auto it = m_values.find(key);
+    return it != m_values.end() ? std::atoi(it->second.c_str()) : defaultValue;
+}
+
+float Arguments::value(const std::string & key, const float defaultValue) const
+{
+    const auto it = m_values.find(key);
+    return it != m_values.end() ? static_cast<float>(std::atof(it->second.c_str())) : defaultValue;
+}
+
+bool Arguments::value(const std::string & key, const bool defaultValue) const
+{
+    const auto it = m_values.find(key);
+    if (it == m_values.end())
+        return defaultValue;
+
+    return it->second == "true" || it->second == "1" || it->second == "on" || it->second == "yes";
+}
+
+} // namespace cgutils
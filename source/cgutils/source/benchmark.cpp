@@ -0,0 +1,567 @@
+
+#include <cgutils/benchmark.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include <cgutils/topology.h>
+
+#include <cgexamples/cgexamples-version.h>
+
+
+namespace
+{
+
+const char * const summaryKeys[] = { "samples", "mean_ns", "median_ns", "stddev_ns", "min_ns", "max_ns" };
+
+
+std::string encoded(const double value)
+{
+    std::stringstream ss;
+    if (std::isfinite(value))
+        ss << std::setprecision(9) << value;
+    else
+        ss << "null";
+
+    return ss.str();
+}
+
+void setEncoded(std::vector<std::pair<std::string, std::string>> & fields, const std::string & key, const std::string & encoded)
+{
+    for (auto & field : fields)
+    {
+        if (field.first != key)
+            continue;
+
+        field.second = encoded;
+        return;
+    }
+    fields.push_back(std::make_pair(key, encoded));
+}
+
+
+std::string hostName()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    char name[256] = { };
+    if (gethostname(name, sizeof(name) - 1) == 0)
+        return name;
+#endif
+    return "unknown";
+}
+
+std::string operatingSystem()
+{
+#if defined(_WIN32)
+    return "windows";
+#elif defined(__APPLE__)
+    return "macos";
+#elif defined(__linux__)
+    return "linux";
+#else
+    return "unknown";
+#endif
+}
+
+
+// Minimal reader for the JSON objects written by BenchmarkResult::toJson, i.e., string
+// keys with string, number, boolean, null, number array, or flat object values.
+class JsonReader
+{
+public:
+    explicit JsonReader(const std::string & json)
+    : m_json(json)
+    , m_pos(0)
+    {
+    }
+
+    bool consume(const char c)
+    {
+        skipWhitespace();
+        if (m_pos >= m_json.size() || m_json[m_pos] != c)
+            return false;
+
+        ++m_pos;
+        return true;
+    }
+
+    char peek()
+    {
+        skipWhitespace();
+        return m_pos < m_json.size() ? m_json[m_pos] : '\0';
+    }
+
+    bool string(std::string & value)
+    {
+        if (!consume('"'))
+            return false;
+
+        value.clear();
+        while (m_pos < m_json.size() && m_json[m_pos] != '"')
+        {
+            auto c = m_json[m_pos++];
+            if (c == '\\' && m_pos < m_json.size())
+            {
+                c = m_json[m_pos++];
+                switch (c)
+                {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'u':
+                {
+                    if (m_pos + 4 > m_json.size())
+                        return false;
+
+                    const auto digits = m_json.substr(m_pos, 4);
+                    if (digits.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+                        return false;
+
+                    c = static_cast<char>(std::stoi(digits, nullptr, 16));
+                    m_pos += 4;
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            value.push_back(c);
+        }
+        return consume('"');
+    }
+
+    // Returns the literal token of a number, boolean, or null.
+    bool literal(std::string & value)
+    {
+        skipWhitespace();
+        const auto end = m_json.find_first_of(",]} \t\r\n", m_pos);
+        value = m_json.substr(m_pos, end == std::string::npos ? std::string::npos : end - m_pos);
+        m_pos = end == std::string::npos ? m_json.size() : end;
+        return !value.empty();
+    }
+
+protected:
+    void skipWhitespace()
+    {
+        while (m_pos < m_json.size() && std::isspace(static_cast<unsigned char>(m_json[m_pos])))
+            ++m_pos;
+    }
+
+protected:
+    const std::string & m_json;
+    std::size_t m_pos;
+};
+
+}
+
+
+namespace cgutils
+{
+
+void BenchmarkResult::set(const std::string & key, const std::string & value)
+{
+    setEncoded(key, "\"" + jsonEscaped(value) + "\"");
+}
+
+void BenchmarkResult::set(const std::string & key, const char * value)
+{
+    set(key, std::string(value ? value : ""));
+}
+
+void BenchmarkResult::set(const std::string & key, const double value)
+{
+    setEncoded(key, encoded(value));
+}
+
+void BenchmarkResult::set(const std::string & key, const std::int64_t value)
+{
+    set(key, static_cast<double>(value));
+}
+
+void BenchmarkResult::set(const std::string & key, const int value)
+{
+    set(key, static_cast<double>(value));
+}
+
+void BenchmarkResult::set(const std::string & key, const bool value)
+{
+    setEncoded(key, value ? "true" : "false");
+}
+
+void BenchmarkResult::setEncoded(const std::string & key, const std::string & encoded)
+{
+    ::setEncoded(m_fields, key, encoded);
+}
+
+void BenchmarkResult::setEnvironment()
+{
+    const auto now = std::time(nullptr);
+    char timestamp[32] = { };
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    set("revision", CGEXAMPLES_VERSION_REVISION);
+    set("timestamp", timestamp);
+    set("host", hostName());
+    set("cpu", cpuModel());
+    set("threads", static_cast<int>(std::thread::hardware_concurrency()));
+    set("os", operatingSystem());
+}
+
+bool BenchmarkResult::has(const std::string & key) const
+{
+    for (const auto & field : m_fields)
+        if (field.first == key)
+            return true;
+
+    return false;
+}
+
+std::string BenchmarkResult::get(const std::string & key) const
+{
+    for (const auto & field : m_fields)
+    {
+        if (field.first != key)
+            continue;
+
+        auto value = std::string();
+        if (field.second.empty() || field.second[0] != '"' || !JsonReader(field.second).string(value))
+            return field.second;
+
+        return value;
+    }
+    return std::string();
+}
+
+const std::vector<std::pair<std::string, std::string>> & BenchmarkResult::fields() const
+{
+    return m_fields;
+}
+
+void BenchmarkResult::setMetric(const std::string & key, const double value)
+{
+    ::setEncoded(m_metrics, key, encoded(value));
+}
+
+std::string BenchmarkResult::metric(const std::string & key) const
+{
+    for (const auto & metric : m_metrics)
+        if (metric.first == key)
+            return metric.second;
+
+    return std::string();
+}
+
+const std::vector<std::pair<std::string, std::string>> & BenchmarkResult::metrics() const
+{
+    return m_metrics;
+}
+
+void BenchmarkResult::addSample(const std::uint64_t nanoseconds)
+{
+    m_samples.push_back(nanoseconds);
+}
+
+const std::vector<std::uint64_t> & BenchmarkResult::samples() const
+{
+    return m_samples;
+}
+
+double BenchmarkResult::mean() const
+{
+    if (m_samples.empty())
+        return 0.0;
+
+    return std::accumulate(m_samples.begin(), m_samples.end(), 0.0) / m_samples.size();
+}
+
+double BenchmarkResult::median() const
+{
+    if (m_samples.empty())
+        return 0.0;
+
+    auto sorted = m_samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    const auto n = sorted.size();
+    return n % 2 ? static_cast<double>(sorted[n / 2]) : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+}
+
+double BenchmarkResult::stddev() const
+{
+    if (m_samples.size() < 2)
+        return 0.0;
+
+    const auto m = mean();
+    auto sum = 0.0;
+    for (const auto sample : m_samples)
+        sum += (sample - m) * (sample - m);
+
+    return std::sqrt(sum / (m_samples.size() - 1));
+}
+
+std::string BenchmarkResult::toJson() const
+{
+    std::stringstream ss;
+    ss << "{";
+
+    for (const auto & field : m_fields)
+        ss << "\"" << jsonEscaped(field.first) << "\": " << field.second << ", ";
+
+    ss << "\"metrics\": {";
+    for (auto i = std::size_t{ 0 }; i < m_metrics.size(); ++i)
+        ss << (i > 0 ? ", " : "") << "\"" << jsonEscaped(m_metrics[i].first) << "\": " << m_metrics[i].second;
+    ss << "}, ";
+
+    const auto minmax = std::minmax_element(m_samples.begin(), m_samples.end());
+
+    ss << std::setprecision(9)
+        << "\"samples\": " << m_samples.size() << ", "
+        << "\"mean_ns\": " << mean() << ", "
+        << "\"median_ns\": " << median() << ", "
+        << "\"stddev_ns\": " << stddev() << ", "
+        << "\"min_ns\": " << (m_samples.empty() ? 0 : *minmax.first) << ", "
+        << "\"max_ns\": " << (m_samples.empty() ? 0 : *minmax.second) << ", "
+        << "\"samples_ns\": [";
+
+    for (auto i = std::size_t{ 0 }; i < m_samples.size(); ++i)
+        ss << (i > 0 ? ", " : "") << m_samples[i];
+
+    ss << "]}";
+
+    return ss.str();
+}
+
+bool BenchmarkResult::fromJson(const std::string & json, BenchmarkResult & result)
+{
+    auto reader = JsonReader(json);
+    if (!reader.consume('{'))
+        return false;
+
+    result = BenchmarkResult();
+
+    auto key = std::string();
+    auto value = std::string();
+    while (reader.peek() != '}')
+    {
+        if (!reader.string(key) || !reader.consume(':'))
+            return false;
+
+        if (reader.peek() == '"')
+        {
+            if (!reader.string(value))
+                return false;
+            result.set(key, value);
+        }
+        else if (reader.consume('['))
+        {
+            while (reader.peek() != ']')
+            {
+                if (!reader.literal(value))
+                    return false;
+                if (key == "samples_ns")
+                {
+                    // digits only and at most 19, so stoull neither throws nor stops early
+                    if (value.size() > 19 || value.find_first_not_of("0123456789") != std::string::npos)
+                        return false;
+                    result.addSample(std::stoull(value));
+                }
+                reader.consume(',');
+            }
+            reader.consume(']');
+        }
+        else if (reader.consume('{'))
+        {
+            auto metric = std::string();
+            while (reader.peek() != '}')
+            {
+                if (!reader.string(metric) || !reader.consume(':') || !reader.literal(value))
+                    return false;
+                if (key == "metrics")
+                    ::setEncoded(result.m_metrics, metric, value);
+                reader.consume(',');
+            }
+            reader.consume('}');
+        }
+        else
+        {
+            if (!reader.literal(value))
+                return false;
+
+            const auto summary = std::find_if(std::begin(summaryKeys), std::end(summaryKeys),
+                [&key](const char * summaryKey) { return key == summaryKey; });
+            if (summary == std::end(summaryKeys))
+                result.setEncoded(key, value);
+        }
+
+        if (!reader.consume(',') && reader.peek() != '}')
+            return false;
+    }
+    return true;
+}
+
+bool BenchmarkResult::write(const std::string & filePath) const
+{
+    if (filePath.empty() || filePath == "-")
+    {
+        std::cout << toJson() << std::endl;
+        return true;
+    }
+
+    auto stream = std::ofstream(filePath);
+    if (!stream)
+    {
+        std::cerr << "Cannot open output file '" << filePath << "'." << std::endl;
+        return false;
+    }
+
+    stream << toJson() << std::endl;
+    return true;
+}
+
+bool BenchmarkResult::append(const std::string & filePath) const
+{
+    auto stream = std::ofstream(filePath, std::ios::app);
+    if (!stream)
+    {
+        std::cerr << "Cannot open results store '" << filePath << "'." << std::endl;
+        return false;
+    }
+
+    stream << toJson() << std::endl;
+    return true;
+}
+
+std::vector<BenchmarkResult> loadBenchmarkResults(const std::string & filePath)
+{
+    auto results = std::vector<BenchmarkResult>();
+
+    auto stream = std::ifstream(filePath);
+    if (!stream)
+    {
+        std::cerr << "Cannot open results store '" << filePath << "'." << std::endl;
+        return results;
+    }
+
+    auto line = std::string();
+    auto lineNumber = 0;
+    while (std::getline(stream, line))
+    {
+        ++lineNumber;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        auto result = BenchmarkResult();
+        if (BenchmarkResult::fromJson(line, result))
+            results.push_back(result);
+        else
+            std::cerr << filePath << ":" << lineNumber << ": skipping malformed result." << std::endl;
+    }
+    return results;
+}
+
+std::string jsonEscaped(const std::string & text)
+{
+    std::stringstream ss;
+    for (const auto c : text)
+    {
+        switch (c)
+        {
+        case '"':  ss << "\\\""; break;
+        case '\\': ss << "\\\\"; break;
+        case '\n': ss << "\\n"; break;
+        case '\r': ss << "\\r"; break;
+        case '\t': ss << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+            else
+                ss << c;
+        }
+    }
+    return ss.str();
+}
+
+void measureFrames(BenchmarkResult & result, const int frames, const int warmup, const std::function<void()> & frame)
+{
+    for (auto i = 0; i < warmup; ++i)
+        frame();
+
+    for (auto i = 0; i < frames; ++i)
+    {
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        frame();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+
+        result.addSample(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+    }
+
+    result.set("frames", frames);
+    result.set("warmup", warmup);
+}
+
+MannWhitneyU mannWhitneyU(const std::vector<std::uint64_t> & a, const std::vector<std::uint64_t> & b)
+{
+    const auto n1 = static_cast<double>(a.size());
+    const auto n2 = static_cast<double>(b.size());
+    if (a.empty() || b.empty())
+        return MannWhitneyU{ 0.0, 0.0, 1.0 };
+
+    // rank the pooled samples, ties get their average rank
+    auto pooled = std::vector<std::pair<std::uint64_t, bool>>(); // sample and whether it stems from a
+    pooled.reserve(a.size() + b.size());
+    for (const auto sample : a)
+        pooled.push_back(std::make_pair(sample, true));
+    for (const auto sample : b)
+        pooled.push_back(std::make_pair(sample, false));
+
+    std::sort(pooled.begin(), pooled.end());
+
+    auto rankSumA = 0.0;
+    auto tieCorrection = 0.0; // sum over all ties of t^3 - t
+    for (auto i = std::size_t{ 0 }; i < pooled.size(); )
+    {
+        auto j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first)
+            ++j;
+
+        const auto rank = 0.5 * static_cast<double>(i + 1 + j); // average of ranks i + 1 to j
+        for (auto k = i; k < j; ++k)
+            if (pooled[k].second)
+                rankSumA += rank;
+
+        const auto t = static_cast<double>(j - i);
+        tieCorrection += t * t * t - t;
+
+        i = j;
+    }
+
+    const auto n = n1 + n2;
+    const auto u = rankSumA - n1 * (n1 + 1.0) * 0.5;
+    const auto mu = n1 * n2 * 0.5;
+    const auto sigma = std::sqrt(n1 * n2 / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0))));
+
+    if (sigma <= 0.0)
+        return MannWhitneyU{ u, 0.0, 1.0 };
+
+    // continuity correction towards the mean
+    const auto delta = u - mu;
+    const auto z = (delta - (delta > 0.0 ? 0.5 : delta < 0.0 ? -0.5 : 0.0)) / sigma;
+
+    return MannWhitneyU{ u, z, std::erfc(std::abs(z) / std::sqrt(2.0)) };
+}
+
+} // namespace cgutils
@@ -1,6 +1,7 @@
 
 #include <cgutils/common.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iostream>
@@ -86,6 +87,35 @@ std::string textFromFile(const char * filePath)
     return std::string(text.begin(), text.end());
 }
 
+std::string injectDefines(const std::string & source, const std::vector<std::string> & defines)
+{
+    if (defines.empty())
+        return source;
+
+    // the #version directive has to remain the first, all others may follow
+    auto position = std::string::size_type(0);
+    auto line = 1;
+
+    const auto version = source.find("#version");
+    if (version != std::string::npos)
+    {
+        const auto end = source.find('\n', version);
+        position = end == std::string::npos ? source.size() : end + 1;
+        line = static_cast<int>(std::count(source.begin(), source.begin() + version, '\n')) + 2;
+    }
+
+    auto injected = std::string();
+    for (const auto & define : defines)
+        injected += "#define " + define + "\n";
+    injected += "#line " + std::to_string(line) + "\n";
+
+    auto result = source.substr(0, position);
+    if (!result.empty() && result.back() != '\n')
+        result += '\n';
+
+    return result + injected + source.substr(position);
+}
+
 bool checkForCompilationError(GLuint shader, const std::string & identifier)
 {
     auto success = static_cast<GLint>(GL_FALSE);
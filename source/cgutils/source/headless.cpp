@@ -0,0 +1,176 @@
+
+#include <cgutils/headless.h>
+
+#include <iostream>
+
+#ifdef CGUTILS_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+
+namespace cgutils
+{
+
+HeadlessContext::HeadlessContext()
+: m_display(nullptr)
+, m_surface(nullptr)
+, m_context(nullptr)
+{
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    destroy();
+}
+
+#ifdef CGUTILS_USE_EGL
+
+bool HeadlessContext::create(const int width, const int height, const int majorVersion, const int minorVersion)
+{
+    destroy();
+
+    auto display = EGL_NO_DISPLAY;
+
+    // prefer the surfaceless platform, which requires neither X11 nor a GBM device
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#endif
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        std::cerr << "Initializing EGL display failed." << std::endl;
+        return false;
+    }
+    m_display = display;
+
+    static const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE,        8,
+        EGL_GREEN_SIZE,      8,
+        EGL_BLUE_SIZE,       8,
+        EGL_ALPHA_SIZE,      8,
+        EGL_DEPTH_SIZE,      24,
+        EGL_NONE };
+
+    auto config = EGLConfig{ nullptr };
+    auto numConfigs = EGLint{ 0 };
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs < 1)
+    {
+        std::cerr << "No EGL config with pbuffer and OpenGL support found." << std::endl;
+        destroy();
+        return false;
+    }
+
+    const EGLint surfaceAttributes[] = {
+        EGL_WIDTH,  width,
+        EGL_HEIGHT, height,
+        EGL_NONE };
+
+    m_surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (m_surface == EGL_NO_SURFACE)
+    {
+        std::cerr << "Creating EGL pbuffer surface (" << width << "x" << height << ") failed." << std::endl;
+        m_surface = nullptr;
+        destroy();
+        return false;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION,       majorVersion,
+        EGL_CONTEXT_MINOR_VERSION,       minorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE };
+
+    m_context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (m_context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "Creating EGL OpenGL " << majorVersion << "." << minorVersion
+            << " core context failed." << std::endl;
+        m_context = nullptr;
+        destroy();
+        return false;
+    }
+
+    makeCurrent();
+
+    return true;
+}
+
+void HeadlessContext::destroy()
+{
+    if (!m_display)
+        return;
+
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (m_context)
+        eglDestroyContext(m_display, m_context);
+    if (m_surface)
+        eglDestroySurface(m_display, m_surface);
+
+    eglTerminate(m_display);
+
+    m_context = nullptr;
+    m_surface = nullptr;
+    m_display = nullptr;
+}
+
+void HeadlessContext::makeCurrent()
+{
+    if (valid())
+        eglMakeCurrent(m_display, m_surface, m_surface, m_context);
+}
+
+void HeadlessContext::doneCurrent()
+{
+    if (m_display)
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void HeadlessContext::swapBuffers()
+{
+    if (valid())
+        eglSwapBuffers(m_display, m_surface);
+}
+
+#else
+
+bool HeadlessContext::create(const int /*width*/, const int /*height*/, const int /*majorVersion*/, const int /*minorVersion*/)
+{
+    std::cerr << "Headless rendering not available: cgutils was built without EGL." << std::endl;
+    return false;
+}
+
+void HeadlessContext::destroy()
+{
+}
+
+void HeadlessContext::makeCurrent()
+{
+}
+
+void HeadlessContext::doneCurrent()
+{
+}
+
+void HeadlessContext::swapBuffers()
+{
+}
+
+#endif
+
+bool HeadlessContext::valid() const
+{
+    return m_display && m_surface && m_context;
+}
+
+} // namespace cgutils
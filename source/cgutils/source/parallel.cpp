@@ -0,0 +1,388 @@
+
+#include <cgutils/parallel.h>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CGUTILS_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace
+{
+
+const auto minimumPerThread = std::size_t{ 1 } << 16; // elements, below which fewer threads are used
+
+const auto digitBits = 8u;
+const auto radix = std::size_t{ 1 } << digitBits;
+
+using Counts = std::array<std::size_t, radix>;
+
+
+unsigned int threadCount(unsigned int threads, const std::size_t count)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    const auto useful = std::max(std::size_t{ 1 }, count / minimumPerThread);
+    return static_cast<unsigned int>(std::min(static_cast<std::size_t>(threads), useful));
+}
+
+// Runs kernel(thread, begin, end) on equally sized contiguous ranges, one thread each; the
+// calling thread takes the first range. The ranges only depend on threads and count.
+void run(const unsigned int threads, const std::size_t count, const std::function<void(unsigned int, std::size_t, std::size_t)> & kernel)
+{
+    auto workers = std::vector<std::thread>();
+    workers.reserve(threads);
+    for (auto t = 1u; t < threads; ++t)
+        workers.emplace_back(kernel, t, count * t / threads, count * (t + 1) / threads);
+
+    kernel(0u, 0, count / threads);
+
+    for (auto & worker : workers)
+        worker.join();
+}
+
+int popcount(const std::uint32_t mask)
+{
+#if defined(_MSC_VER)
+    return static_cast<int>(__popcnt(mask));
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+int trailingZeros(const std::uint32_t mask)
+{
+#if defined(_MSC_VER)
+    auto index = 0ul;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+
+template <typename Key>
+void sortByDigits(Key * keys, std::uint32_t * values, const std::size_t count, unsigned int threads)
+{
+    if (count < 2)
+        return;
+
+    threads = threadCount(threads, count);
+    const auto passes = sizeof(Key) * 8 / digitBits;
+
+    // digit counts of all passes per thread in a single read; they remain valid for the first
+    // pass only, as each scatter changes the contents of the ranges
+
+    auto counts = std::vector<Counts>(threads * passes);
+    run(threads, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+    {
+        const auto local = &counts[t * passes];
+        for (auto i = begin; i < end; ++i)
+        {
+            const auto key = keys[i];
+            for (auto pass = std::size_t{ 0 }; pass < passes; ++pass)
+                ++local[pass][(key >> (pass * digitBits)) & (radix - 1)];
+        }
+    });
+
+    auto keyBuffer = std::unique_ptr<Key[]>(new Key[count]);
+    auto valueBuffer = std::unique_ptr<std::uint32_t[]>(values ? new std::uint32_t[count] : nullptr);
+
+    auto sourceKeys = keys;
+    auto targetKeys = keyBuffer.get();
+    auto sourceValues = values;
+    auto targetValues = valueBuffer.get();
+
+    auto offsets = std::vector<Counts>(threads);
+    auto first = true;
+
+    for (auto pass = std::size_t{ 0 }; pass < passes; ++pass)
+    {
+        const auto shift = pass * digitBits;
+
+        auto total = Counts();
+        for (auto t = 0u; t < threads; ++t)
+        {
+            for (auto digit = std::size_t{ 0 }; digit < radix; ++digit)
+                total[digit] += counts[t * passes + pass][digit];
+        }
+
+        // all keys share the digit, thus the order would not change
+        if (std::find(total.begin(), total.end(), count) != total.end())
+            continue;
+
+        if (!first)
+        {
+            run(threads, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+            {
+                auto & local = counts[t * passes + pass];
+                local.fill(0);
+                for (auto i = begin; i < end; ++i)
+                    ++local[(sourceKeys[i] >> shift) & (radix - 1)];
+            });
+        }
+        first = false;
+
+        // each thread scatters its digits after all smaller digits and the same digit of the preceding threads
+
+        auto base = std::size_t{ 0 };
+        for (auto digit = std::size_t{ 0 }; digit < radix; ++digit)
+        {
+            for (auto t = 0u; t < threads; ++t)
+            {
+                offsets[t][digit] = base;
+                base += counts[t * passes + pass][digit];
+            }
+        }
+
+        run(threads, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+        {
+            auto & offset = offsets[t];
+            if (sourceValues)
+            {
+                for (auto i = begin; i < end; ++i)
+                {
+                    const auto target = offset[(sourceKeys[i] >> shift) & (radix - 1)]++;
+                    targetKeys[target] = sourceKeys[i];
+                    targetValues[target] = sourceValues[i];
+                }
+            }
+            else
+            {
+                for (auto i = begin; i < end; ++i)
+                    targetKeys[offset[(sourceKeys[i] >> shift) & (radix - 1)]++] = sourceKeys[i];
+            }
+        });
+
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourceValues, targetValues);
+    }
+
+    if (sourceKeys == keys)
+        return;
+
+    run(threads, count, [&](const unsigned int, const std::size_t begin, const std::size_t end)
+    {
+        std::copy(sourceKeys + begin, sourceKeys + end, keys + begin);
+        if (values)
+            std::copy(sourceValues + begin, sourceValues + end, values + begin);
+    });
+}
+
+
+std::uint64_t sum(const std::uint32_t * input, const std::size_t count)
+{
+    auto i = std::size_t{ 0 };
+    auto result = std::uint64_t{ 0 };
+
+#ifdef CGUTILS_USE_SSE2
+    // widened to 64-bit lanes, which cannot overflow
+    const auto zero = _mm_setzero_si128();
+    auto accumulator = zero;
+    for (; i + 4 <= count; i += 4)
+    {
+        const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        accumulator = _mm_add_epi64(accumulator, _mm_add_epi64(_mm_unpacklo_epi32(x, zero), _mm_unpackhi_epi32(x, zero)));
+    }
+
+    std::uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), accumulator);
+    result = lanes[0] + lanes[1];
+#endif
+
+    for (; i < count; ++i)
+        result += input[i];
+
+    return result;
+}
+
+// Returns the sum of the inputs, as for sum.
+std::uint64_t scan(const std::uint32_t * input, std::uint32_t * output, const std::size_t count, std::uint32_t carry)
+{
+    auto i = std::size_t{ 0 };
+    auto result = std::uint64_t{ 0 };
+
+#ifdef CGUTILS_USE_SSE2
+    // inclusive prefix sum of four elements by two shifted additions, the carry is broadcast
+    const auto zero = _mm_setzero_si128();
+    auto offset = _mm_set1_epi32(static_cast<int>(carry));
+    auto accumulator = zero;
+    for (; i + 4 <= count; i += 4)
+    {
+        const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        auto inclusive = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        inclusive = _mm_add_epi32(inclusive, _mm_slli_si128(inclusive, 8));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), _mm_add_epi32(offset, _mm_sub_epi32(inclusive, x)));
+        offset = _mm_add_epi32(offset, _mm_shuffle_epi32(inclusive, _MM_SHUFFLE(3, 3, 3, 3)));
+        accumulator = _mm_add_epi64(accumulator, _mm_add_epi64(_mm_unpacklo_epi32(x, zero), _mm_unpackhi_epi32(x, zero)));
+    }
+    carry = static_cast<std::uint32_t>(_mm_cvtsi128_si32(offset));
+
+    std::uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), accumulator);
+    result = lanes[0] + lanes[1];
+#endif
+
+    for (; i < count; ++i)
+    {
+        const auto x = input[i];
+        output[i] = carry;
+        carry += x;
+        result += x;
+    }
+
+    return result;
+}
+
+
+std::size_t countNonzero(const std::uint8_t * flags, const std::size_t count)
+{
+    auto i = std::size_t{ 0 };
+    auto result = std::size_t{ 0 };
+
+#ifdef CGUTILS_USE_SSE2
+    const auto zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(flags + i));
+        result += static_cast<std::size_t>(popcount(~static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero))) & 0xFFFFu));
+    }
+#endif
+
+    for (; i < count; ++i)
+        result += flags[i] != 0 ? 1 : 0;
+
+    return result;
+}
+
+void writeNonzero(const std::uint8_t * flags, const std::size_t begin, const std::size_t end, std::uint32_t * indices)
+{
+    auto i = begin;
+
+#ifdef CGUTILS_USE_SSE2
+    // sixteen flags per mask; runs of zero flags cost a single compare
+    const auto zero = _mm_setzero_si128();
+    for (; i + 16 <= end; i += 16)
+    {
+        const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(flags + i));
+        auto mask = ~static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero))) & 0xFFFFu;
+        while (mask)
+        {
+            *indices++ = static_cast<std::uint32_t>(i + trailingZeros(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        if (flags[i] != 0)
+            *indices++ = static_cast<std::uint32_t>(i);
+    }
+}
+
+}
+
+
+namespace cgutils
+{
+
+void radixSort(std::uint32_t * keys, std::uint32_t * values, const std::size_t count, const unsigned int threads)
+{
+    sortByDigits(keys, values, count, threads);
+}
+
+void radixSort(std::uint64_t * keys, std::uint32_t * values, const std::size_t count, const unsigned int threads)
+{
+    sortByDigits(keys, values, count, threads);
+}
+
+std::uint64_t exclusiveScan(const std::uint32_t * input, std::uint32_t * output, const std::size_t count, unsigned int threads)
+{
+    threads = threadCount(threads, count);
+
+    if (threads == 1)
+        return scan(input, output, count, 0u);
+
+    // sum per range, scanned sequentially, then each range scanned from its offset
+    auto sums = std::vector<std::uint64_t>(threads + 1);
+    run(threads, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+    {
+        sums[t + 1] = sum(input + begin, end - begin);
+    });
+
+    for (auto t = 0u; t < threads; ++t)
+        sums[t + 1] += sums[t];
+
+    run(threads, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+    {
+        scan(input + begin, output + begin, end - begin, static_cast<std::uint32_t>(sums[t]));
+    });
+
+    return sums[threads];
+}
+
+std::size_t compactIndices(const std::uint8_t * flags, std::uint32_t * indices, const std::size_t count, unsigned int threads)
+{
+    threads = threadCount(threads, count);
+
+    auto offsets = std::vector<std::size_t>(threads + 1);
+    run(threads, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+    {
+        offsets[t + 1] = countNonzero(flags + begin, end - begin);
+    });
+
+    for (auto t = 0u; t < threads; ++t)
+        offsets[t + 1] += offsets[t];
+
+    run(threads, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+    {
+        writeNonzero(flags, begin, end, indices + offsets[t]);
+    });
+
+    return offsets[threads];
+}
+
+void histogram(const std::uint32_t * values, const std::size_t count, std::uint32_t * bins, const std::size_t numBins, const unsigned int threads)
+{
+    const auto counting = threadCount(threads, count);
+
+    // private bins per thread, summed afterwards, thus no atomics and no shared cache lines
+    auto local = std::vector<std::vector<std::uint32_t>>(counting);
+    run(counting, count, [&](const unsigned int t, const std::size_t begin, const std::size_t end)
+    {
+        auto & own = local[t];
+        own.assign(numBins, 0u);
+        for (auto i = begin; i < end; ++i)
+        {
+            if (values[i] < numBins)
+                ++own[values[i]];
+        }
+    });
+
+    run(threadCount(threads, numBins * counting), numBins, [&](const unsigned int, const std::size_t begin, const std::size_t end)
+    {
+        std::fill(bins + begin, bins + end, 0u);
+        for (const auto & own : local)
+        {
+            for (auto bin = begin; bin < end; ++bin)
+                bins[bin] += own[bin];
+        }
+    });
+}
+
+} // namespace cgutils
@@ -0,0 +1,191 @@
+
+#include <cgutils/perfcounters.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+
+const char * const eventNames[] = { "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses" };
+
+#if defined(__linux__)
+
+perf_event_attr eventAttributes(const cgutils::PerfCounters::Event event)
+{
+    auto attributes = perf_event_attr();
+    std::memset(&attributes, 0, sizeof(attributes));
+
+    attributes.size = sizeof(attributes);
+    attributes.disabled = 1;
+    attributes.inherit = 1;        // include threads created after opening
+    attributes.exclude_kernel = 1; // permitted with perf_event_paranoid <= 2
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event)
+    {
+    case cgutils::PerfCounters::Event::Cycles:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case cgutils::PerfCounters::Event::Instructions:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case cgutils::PerfCounters::Event::LLCMisses:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_LL
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case cgutils::PerfCounters::Event::DTLBMisses:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_DTLB
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case cgutils::PerfCounters::Event::BranchMisses:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    default:
+        break;
+    }
+
+    return attributes;
+}
+
+#endif
+
+}
+
+
+namespace cgutils
+{
+
+PerfCounters::PerfCounters()
+: m_running(false)
+{
+    m_fds.fill(-1);
+    m_values.fill(0);
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open()
+{
+    close();
+
+#if defined(__linux__)
+    for (auto i = 0; i < numEvents; ++i)
+    {
+        auto attributes = eventAttributes(static_cast<Event>(i));
+
+        // the events are opened individually since reading groups of inherited events is not supported
+        m_fds[i] = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+        if (m_fds[i] < 0)
+            std::cerr << "Performance counter " << eventNames[i] << " not available: " << std::strerror(errno) << std::endl;
+    }
+#else
+    std::cerr << "Performance counters not available on this platform." << std::endl;
+#endif
+
+    return available();
+}
+
+void PerfCounters::close()
+{
+#if defined(__linux__)
+    for (auto & fd : m_fds)
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+#endif
+    m_running = false;
+}
+
+bool PerfCounters::available() const
+{
+    for (const auto fd : m_fds)
+        if (fd >= 0)
+            return true;
+
+    return false;
+}
+
+bool PerfCounters::available(const Event event) const
+{
+    return m_fds[static_cast<int>(event)] >= 0;
+}
+
+void PerfCounters::start()
+{
+#if defined(__linux__)
+    for (const auto fd : m_fds)
+    {
+        if (fd < 0)
+            continue;
+
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    m_running = true;
+}
+
+void PerfCounters::stop()
+{
+    if (!m_running)
+        return;
+
+#if defined(__linux__)
+    for (const auto fd : m_fds)
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    for (auto i = 0; i < numEvents; ++i)
+    {
+        if (m_fds[i] < 0)
+            continue;
+
+        std::uint64_t data[3] = { }; // value, time enabled, time running
+        if (read(m_fds[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0)
+            continue;
+
+        // extrapolate if the hardware counters were multiplexed
+        m_values[i] += data[1] == data[2] ? data[0]
+            : static_cast<std::uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+    }
+#endif
+    m_running = false;
+}
+
+void PerfCounters::reset()
+{
+    m_values.fill(0);
+}
+
+std::uint64_t PerfCounters::value(const Event event) const
+{
+    return m_values[static_cast<int>(event)];
+}
+
+const char * PerfCounters::name(const Event event)
+{
+    return eventNames[static_cast<int>(event)];
+}
+
+} // namespace cgutils
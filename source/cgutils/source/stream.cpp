@@ -0,0 +1,103 @@
+
+#include <cgutils/stream.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+// Runs kernel(begin, end) on equally sized contiguous ranges, one thread each,
+// and returns the wall time in seconds.
+double run(const unsigned int threads, const std::size_t elements, const std::function<void(std::size_t, std::size_t)> & kernel)
+{
+    const auto t0 = std::chrono::high_resolution_clock::now();
+
+    if (threads == 1)
+        kernel(0, elements);
+    else
+    {
+        auto workers = std::vector<std::thread>();
+        workers.reserve(threads);
+        for (auto t = 0u; t < threads; ++t)
+            workers.emplace_back(kernel, elements * t / threads, elements * (t + 1) / threads);
+
+        for (auto & worker : workers)
+            worker.join();
+    }
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count();
+}
+
+}
+
+
+namespace cgutils
+{
+
+StreamBandwidth measureStreamBandwidth(unsigned int threads, const std::size_t elements, const int repetitions)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto a = std::unique_ptr<double[]>(new double[elements]);
+    auto b = std::unique_ptr<double[]>(new double[elements]);
+    auto c = std::unique_ptr<double[]>(new double[elements]);
+
+    const auto pa = a.get();
+    const auto pb = b.get();
+    const auto pc = c.get();
+
+    // first touch by the measuring threads places pages on their NUMA nodes
+    run(threads, elements, [pa, pb, pc](const std::size_t begin, const std::size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            pa[i] = 1.0;
+            pb[i] = 2.0;
+            pc[i] = 0.0;
+        }
+    });
+
+    const auto scalar = 3.0;
+    auto copy = 0.0;
+    auto triad = 0.0;
+
+    for (auto r = 0; r < repetitions; ++r)
+    {
+        const auto copyTime = run(threads, elements, [pa, pc](const std::size_t begin, const std::size_t end)
+        {
+            for (auto i = begin; i < end; ++i)
+                pc[i] = pa[i];
+        });
+
+        const auto triadTime = run(threads, elements, [pa, pb, pc, scalar](const std::size_t begin, const std::size_t end)
+        {
+            for (auto i = begin; i < end; ++i)
+                pa[i] = pb[i] + scalar * pc[i];
+        });
+
+        copy = std::max(copy, 2.0 * sizeof(double) * elements / copyTime);
+        triad = std::max(triad, 3.0 * sizeof(double) * elements / triadTime);
+    }
+
+    return StreamBandwidth{ threads, copy, triad };
+}
+
+StreamResult measureStream(const std::size_t elements, const int repetitions)
+{
+    auto result = StreamResult();
+
+    result.single = measureStreamBandwidth(1, elements, repetitions);
+    result.all = measureStreamBandwidth(0, elements, repetitions);
+
+    return result;
+}
+
+} // namespace cgutils
@@ -0,0 +1,153 @@
+
+#include <cgutils/topology.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+
+namespace
+{
+
+#if defined(__linux__)
+
+// CPUs the process may run on, captured before any thread was pinned.
+const cpu_set_t & processAffinity()
+{
+    static const auto mask = []()
+    {
+        auto set = cpu_set_t();
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        {
+            const auto count = std::max(1u, std::thread::hardware_concurrency());
+            for (auto cpu = 0u; cpu < count; ++cpu)
+                CPU_SET(cpu, &set);
+        }
+        return set;
+    }();
+
+    return mask;
+}
+
+// Parses CPU lists as used by sysfs, e.g., "0,64" or "0-3,8".
+std::vector<int> parseList(const std::string & list)
+{
+    auto cpus = std::vector<int>();
+    auto stream = std::stringstream(list);
+    auto range = std::string();
+
+    while (std::getline(stream, range, ','))
+    {
+        const auto dash = range.find('-');
+        try
+        {
+            const auto first = std::stoi(range.substr(0, dash));
+            const auto last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (auto cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        catch (...)
+        {
+            continue;
+        }
+    }
+    return cpus;
+}
+
+#endif
+
+}
+
+
+namespace cgutils
+{
+
+std::string cpuModel()
+{
+#if defined(__linux__)
+    auto stream = std::ifstream("/proc/cpuinfo");
+    auto line = std::string();
+    while (std::getline(stream, line))
+    {
+        if (line.compare(0, 10, "model name") != 0)
+            continue;
+
+        const auto colon = line.find(':');
+        if (colon != std::string::npos && colon + 2 <= line.size())
+            return line.substr(colon + 2);
+    }
+#endif
+    return "unknown";
+}
+
+std::vector<std::vector<int>> cpuCores()
+{
+    auto cores = std::vector<std::vector<int>>();
+
+#if defined(__linux__)
+    const auto & mask = processAffinity();
+
+    auto siblings = std::map<std::vector<int>, std::vector<int>>(); // sibling list to available cpus
+    for (auto cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &mask))
+            continue;
+
+        auto stream = std::ifstream("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+        auto list = std::string();
+        auto key = std::getline(stream, list) ? parseList(list) : std::vector<int>();
+        if (key.empty())
+            key.push_back(cpu);
+
+        siblings[key].push_back(cpu);
+    }
+
+    for (const auto & core : siblings)
+        cores.push_back(core.second);
+
+    std::sort(cores.begin(), cores.end());
+#else
+    const auto count = std::max(1u, std::thread::hardware_concurrency());
+    for (auto cpu = 0u; cpu < count; ++cpu)
+        cores.push_back(std::vector<int>{ static_cast<int>(cpu) });
+#endif
+
+    return cores;
+}
+
+bool pinCurrentThread(const int cpu)
+{
+#if defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+
+    auto set = cpu_set_t();
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool unpinCurrentThread()
+{
+#if defined(__linux__)
+    auto set = processAffinity();
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+} // namespace cgutils
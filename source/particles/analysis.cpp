@@ -0,0 +1,541 @@
+#include "analysis.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <glbinding/ContextInfo.h>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+#include <cgutils/benchmark.h>
+#include <cgutils/stream.h>
+#include <cgutils/topology.h>
+
+
+namespace
+{
+
+    using ProcessingMode = Particles::ProcessingMode;
+
+    const auto processingModes = std::array<ProcessingMode, 7>{
+        ProcessingMode::CPU, ProcessingMode::CPU_OMP, ProcessingMode::CPU_OMP_SSE41,
+        ProcessingMode::CPU_OMP_AVX2, ProcessingMode::CPU_OMP_AVX512, ProcessingMode::CPU_OMP_Compact,
+        ProcessingMode::GPU_ComputeShaders };
+
+    using DrawingMode = Particles::DrawingMode;
+
+    const auto quadDrawingModes = std::array<DrawingMode, 3>{
+        DrawingMode::CustomQuads, DrawingMode::ShadedQuads, DrawingMode::Fluid };
+
+    const auto drawingWarmupFrames = 5; // the draw time is read back one frame late
+
+    const auto stepElapsed = 0.016f; // in seconds
+    const auto minimumMeasureTime = 0.25; // in seconds
+    const auto minimumTuningTime = 0.1; // in seconds, per configuration
+    const auto minimumSteps = 5;
+
+    // Fraction of the bandwidth ceiling from which on a kernel is considered at the limit.
+    const auto limitFraction = 0.8;
+
+    // Largest deviation in m and m/s from the scalar reference that is attributed to rounding.
+    const auto verificationTolerance = 1e-4f;
+
+    const auto integrationSchemes = std::array<Integration::Scheme, 4>{
+        Integration::Scheme::Taylor, Integration::Scheme::VelocityVerlet,
+        Integration::Scheme::Exponential, Integration::Scheme::RungeKutta4 };
+
+
+    // static schedule chunk sizes in loop iterations, 0 for one equally sized chunk per thread
+    const auto tuningChunkSizes = std::array<int, 4>{ 0, 1024, 16384, 131072 };
+
+    // work group sizes and particles per invocation of the compute shader processing
+    const auto tuningGroupSizes = std::array<int, 6>{ 32, 64, 128, 256, 512, 1024 };
+    const auto tuningParticlesPerThread = std::array<int, 4>{ 1, 2, 4, 8 };
+
+    // Fraction by which a configuration with fewer threads may be slower and still be preferred.
+    const auto tuningTolerance = 0.02;
+
+
+    // Returns the average wall time of a processing step in seconds after a warm up step.
+    double secondsPerStep(Particles & particles, const ProcessingMode mode, const double minimumTime = minimumMeasureTime)
+    {
+        particles.step(mode, stepElapsed);
+
+        auto steps = 0;
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        auto seconds = 0.0;
+
+        while (steps < minimumSteps || seconds < minimumTime)
+        {
+            particles.step(mode, stepElapsed);
+            ++steps;
+            seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+        }
+        return seconds / steps;
+    }
+
+#ifdef USE_OPENMP
+
+    // Sets the OpenMP team size and pins each thread of the team to one of the given cpus;
+    // the runtime reuses the threads of a team of equal size for subsequent regions.
+    void placeThreads(const int threads, const std::vector<int> & cpus)
+    {
+        omp_set_num_threads(threads);
+
+    #pragma omp parallel num_threads(threads)
+        {
+            cgutils::pinCurrentThread(cpus[omp_get_thread_num() % cpus.size()]);
+        }
+    }
+
+    void releaseThreads(const int threads)
+    {
+        omp_set_num_threads(threads);
+
+    #pragma omp parallel num_threads(threads)
+        {
+            cgutils::unpinCurrentThread();
+        }
+    }
+
+#endif
+
+    std::vector<int> threadCounts(const int maximum)
+    {
+        auto counts = std::vector<int>();
+        for (auto count = 1; count < maximum; count *= 2)
+            counts.push_back(count);
+        counts.push_back(maximum);
+
+        return counts;
+    }
+
+
+    const cgutils::StreamResult & streamResult()
+    {
+        static const auto result = cgutils::measureStream();
+        return result;
+    }
+
+}
+
+
+void rooflineReport(Particles & particles, std::ostream & stream)
+{
+    const auto & bandwidth = streamResult();
+
+    stream << std::fixed << std::setprecision(2)
+        << "stream,threads,copy_gbs,triad_gbs" << std::endl
+        << "single," << bandwidth.single.threads << "," << bandwidth.single.copy * 1e-9 << "," << bandwidth.single.triad * 1e-9 << std::endl
+        << "all," << bandwidth.all.threads << "," << bandwidth.all.copy * 1e-9 << "," << bandwidth.all.triad * 1e-9 << std::endl
+        << std::endl;
+
+    const auto restore = particles.processing();
+
+    const auto num = static_cast<double>(particles.numParticles());
+    const auto flops = static_cast<double>(Particles::flopsPerParticle());
+
+    stream << "mode,particles,flop_per_byte,gflops,achieved_gbs,ceiling_gbs,ceiling_percent,verdict" << std::endl;
+
+    for (const auto mode : processingModes)
+    {
+        if (!particles.available(mode))
+            continue;
+
+        const auto seconds = secondsPerStep(particles, mode);
+
+        const auto bytes = static_cast<double>(Particles::bytesPerParticle(mode));
+        const auto achieved = num * bytes / seconds;
+        const auto gflops = num * flops / seconds * 1e-9;
+
+        stream << Particles::toString(mode) << "," << particles.numParticles() << ","
+            << flops / bytes << "," << gflops << "," << achieved * 1e-9 << ",";
+
+        // the ceiling of the GPU is not probed; the triad of a single thread bounds the serial kernel
+        if (mode == ProcessingMode::GPU_ComputeShaders)
+        {
+            stream << ",,n/a" << std::endl;
+            continue;
+        }
+
+        const auto ceiling = mode == ProcessingMode::CPU ? bandwidth.single.triad : bandwidth.all.triad;
+        const auto fraction = achieved / ceiling;
+
+        stream << ceiling * 1e-9 << "," << fraction * 100.0 << ","
+            << (fraction >= limitFraction ? "at bandwidth limit" : "headroom") << std::endl;
+    }
+
+    particles.setProcessing(restore);
+}
+
+void verificationReport(Particles & particles, std::ostream & stream)
+{
+    const auto restore = particles.integrator();
+
+    stream << std::scientific << std::setprecision(2) << "mode,integrator,particles,max_deviation,verdict" << std::endl;
+
+    auto modes = std::vector<ProcessingMode>(processingModes.begin(), processingModes.end());
+    modes.push_back(ProcessingMode::CPU_OMP_BarnesHut);
+
+    for (const auto mode : modes)
+    {
+        // the half float velocities of the compact storage are not expected to match
+        if (mode == ProcessingMode::CPU || mode == ProcessingMode::GPU_ComputeShaders || mode == ProcessingMode::CPU_OMP_Compact
+            || !particles.available(mode))
+            continue;
+
+        for (const auto scheme : integrationSchemes)
+        {
+            particles.setIntegrator(scheme);
+            const auto deviation = particles.deviation(mode, stepElapsed);
+
+            stream << Particles::toString(mode) << "," << Integration::toString(scheme) << "," << particles.numActiveParticles() << ","
+                << deviation << "," << (deviation <= verificationTolerance ? "pass" : "fail") << std::endl;
+        }
+    }
+
+    particles.setIntegrator(restore);
+}
+
+void scalingReport(Particles & particles, std::ostream & stream, const std::vector<int> & particleCounts, const float minimumEfficiency)
+{
+#ifdef USE_OPENMP
+    const auto cores = cgutils::cpuCores();
+
+    // one thread per physical core vs. SMT siblings packed onto as few cores as possible
+    auto scattered = std::vector<int>();
+    auto packed = std::vector<int>();
+    for (const auto & core : cores)
+    {
+        scattered.push_back(core.front());
+        packed.insert(packed.end(), core.begin(), core.end());
+    }
+    const auto smt = packed.size() > scattered.size();
+
+    const auto restoreMode = particles.processing();
+    const auto restoreCount = particles.numParticles();
+    const auto restoreThreads = omp_get_max_threads();
+
+    stream << cores.size() << " physical cores, " << packed.size() << " logical cpus"
+        << (smt ? "" : " (no SMT siblings available)") << std::endl << std::endl;
+
+    stream << std::fixed << "mode,particles,placement,threads,ms_per_step,speedup,efficiency,serial_fraction" << std::endl;
+
+    struct Recommendation
+    {
+        ProcessingMode mode;
+        int particles;
+        const char * placement;
+        int threads;
+        double seconds;
+        double efficiency;
+        double serialFraction;
+        double smtGain; // speedup of all logical cpus over one thread per core
+    };
+    auto recommendations = std::vector<Recommendation>();
+
+    for (const auto count : particleCounts)
+    {
+        particles.setNumParticles(count);
+
+        for (const auto mode : processingModes)
+        {
+            if (mode == ProcessingMode::CPU || mode == ProcessingMode::GPU_ComputeShaders || !particles.available(mode))
+                continue;
+
+            auto best = Recommendation{ mode, count, "", 0, 0.0, 0.0, 0.0, 0.0 };
+            auto serialFractions = std::vector<double>();
+            auto single = 0.0;
+            auto scatteredAll = 0.0;
+            auto packedAll = 0.0;
+
+            for (const auto placement : { 0, 1 })
+            {
+                if (placement == 1 && !smt)
+                    break;
+
+                const auto & cpus = placement == 0 ? scattered : packed;
+                const auto name = placement == 0 ? "core" : "smt";
+
+                for (const auto threads : threadCounts(static_cast<int>(cpus.size())))
+                {
+                    // the single threaded run is equal for both placements
+                    if (placement == 1 && threads == 1)
+                        continue;
+
+                    placeThreads(threads, cpus);
+                    const auto seconds = secondsPerStep(particles, mode);
+
+                    if (threads == 1)
+                        single = seconds;
+                    if (threads == static_cast<int>(cpus.size()))
+                        (placement == 0 ? scatteredAll : packedAll) = seconds;
+
+                    const auto speedup = single / seconds;
+                    const auto efficiency = speedup / threads;
+
+                    // Karp-Flatt metric, i.e., the serial fraction according to Amdahl's law
+                    const auto serialFraction = threads > 1 ? (1.0 / speedup - 1.0 / threads) / (1.0 - 1.0 / threads) : 0.0;
+                    if (threads > 1)
+                        serialFractions.push_back(serialFraction);
+
+                    stream << std::setprecision(3) << Particles::toString(mode) << "," << count << "," << name << "," << threads << ","
+                        << seconds * 1e3 << "," << speedup << "," << efficiency << "," << serialFraction << std::endl;
+
+                    if (efficiency >= minimumEfficiency && (best.threads == 0 || seconds < best.seconds))
+                        best = Recommendation{ mode, count, name, threads, seconds, efficiency, serialFraction, 0.0 };
+                }
+            }
+
+            if (!serialFractions.empty())
+                std::sort(serialFractions.begin(), serialFractions.end());
+            best.serialFraction = serialFractions.empty() ? 0.0 : serialFractions[serialFractions.size() / 2];
+            best.smtGain = packedAll > 0.0 ? scatteredAll / packedAll : 1.0;
+
+            recommendations.push_back(best);
+        }
+    }
+
+    releaseThreads(restoreThreads);
+
+    particles.setNumParticles(restoreCount);
+    particles.setProcessing(restoreMode);
+
+    stream << std::endl << "recommendation (minimum efficiency " << std::setprecision(2) << minimumEfficiency << ")" << std::endl
+        << "mode,particles,placement,threads,ms_per_step,efficiency,median_serial_fraction,smt_gain" << std::endl;
+
+    for (const auto & r : recommendations)
+    {
+        stream << std::setprecision(3) << Particles::toString(r.mode) << "," << r.particles << "," << r.placement << ","
+            << r.threads << "," << r.seconds * 1e3 << "," << r.efficiency << "," << r.serialFraction << ","
+            << r.smtGain << std::endl;
+    }
+
+    if (smt)
+        stream << std::endl << "smt_gain below 1.1 indicates that SMT siblings add little throughput, "
+            << "i.e., one thread per physical core suffices." << std::endl;
+#else
+    (void)particles;
+    (void)particleCounts;
+    (void)minimumEfficiency;
+
+    stream << "Thread scaling requires OpenMP." << std::endl;
+#endif
+}
+
+void drawingReport(Particles & particles, std::ostream & stream, const std::vector<int> & particleCounts, const int frames)
+{
+    const auto restoreNum = particles.numParticles();
+    const auto restoreDrawing = particles.drawing();
+    const auto restorePulling = particles.vertexPulling();
+
+    stream << std::fixed << std::setprecision(3)
+        << "particles,drawing,expansion,draw_ms,mparticles_per_s" << std::endl;
+
+    for (const auto num : particleCounts)
+    {
+        particles.setNumParticles(num);
+
+        for (const auto mode : quadDrawingModes)
+        {
+            particles.setDrawing(mode);
+
+            for (const auto pulling : { false, true })
+            {
+                particles.setVertexPulling(pulling);
+
+                auto milliseconds = 0.0;
+                for (auto frame = 0; frame < drawingWarmupFrames + frames; ++frame)
+                {
+                    particles.render();
+                    gl::glFinish();
+
+                    if (frame >= drawingWarmupFrames)
+                        milliseconds += particles.drawTime();
+                }
+                milliseconds /= std::max(frames, 1);
+
+                stream << num << "," << Particles::toString(mode) << ","
+                    << (particles.vertexPullingActive() ? "vertex" : "geometry") << "," << milliseconds << ","
+                    << (milliseconds > 0.0 ? particles.numActiveParticles() / milliseconds * 1e-3 : 0.0) << std::endl;
+            }
+        }
+    }
+
+    particles.setVertexPulling(restorePulling);
+    particles.setDrawing(restoreDrawing);
+    particles.setNumParticles(restoreNum);
+}
+
+std::string hostKey()
+{
+    const auto cores = cgutils::cpuCores();
+
+    auto logical = std::size_t{ 0 };
+    for (const auto & core : cores)
+        logical += core.size();
+
+    const auto version = reinterpret_cast<const char *>(gl::glGetString(gl::GL_VERSION));
+
+    std::stringstream key;
+    key << cgutils::cpuModel() << " | " << cores.size() << " cores, " << logical << " threads | "
+        << glbinding::ContextInfo::renderer() << " | " << (version ? version : "unknown");
+
+    return key.str();
+}
+
+Tuning autotune(Particles & particles, std::ostream & stream)
+{
+    const auto restoreMode = particles.processing();
+    const auto restoreThreads = particles.threads();
+    const auto restoreChunkSize = particles.chunkSize();
+    const auto restoreGroupSize = particles.computeGroupSize();
+    const auto restoreParticlesPerThread = particles.computeParticlesPerThread();
+
+    auto logical = 0;
+    for (const auto & core : cgutils::cpuCores())
+        logical += static_cast<int>(core.size());
+
+    auto candidates = std::vector<Tuning>();
+
+    stream << std::fixed << std::setprecision(3) << "mode,particles,threads,chunk_size,group_size,particles_per_thread,ms_per_step" << std::endl;
+
+    for (const auto mode : processingModes)
+    {
+        // the compact storage trades precision for memory and is chosen explicitly only
+        if (!particles.available(mode) || mode == ProcessingMode::CPU_OMP_Compact)
+            continue;
+
+        const auto parallel = mode != ProcessingMode::CPU && mode != ProcessingMode::GPU_ComputeShaders;
+
+#ifdef USE_OPENMP
+        const auto threads = parallel ? threadCounts(logical) : std::vector<int>{ 0 };
+#else
+        const auto threads = std::vector<int>{ 0 };
+#endif
+        const auto chunkSizes = parallel ? std::vector<int>(tuningChunkSizes.begin(), tuningChunkSizes.end()) : std::vector<int>{ 0 };
+
+        const auto compute = mode == ProcessingMode::GPU_ComputeShaders;
+        auto groupSizes = std::vector<int>{ restoreGroupSize };
+        auto particlesPerThread = std::vector<int>{ restoreParticlesPerThread };
+        if (compute)
+        {
+            groupSizes.clear();
+            for (const auto groupSize : tuningGroupSizes)
+            {
+                if (groupSize <= particles.maxComputeGroupSize())
+                    groupSizes.push_back(groupSize);
+            }
+            particlesPerThread.assign(tuningParticlesPerThread.begin(), tuningParticlesPerThread.end());
+        }
+
+        for (const auto threadCount : threads)
+        {
+            for (const auto chunkSize : chunkSizes)
+            {
+                for (const auto groupSize : groupSizes)
+                {
+                    for (const auto perThread : particlesPerThread)
+                    {
+                        particles.setThreads(threadCount);
+                        particles.setChunkSize(chunkSize);
+                        particles.setComputeConfiguration(groupSize, perThread);
+
+                        const auto seconds = secondsPerStep(particles, mode, minimumTuningTime);
+                        candidates.push_back(Tuning{ mode, threadCount, chunkSize, groupSize, perThread, seconds });
+
+                        stream << Particles::toString(mode) << "," << particles.numParticles() << "," << threadCount << ","
+                            << chunkSize << "," << groupSize << "," << perThread << "," << seconds * 1e3 << std::endl;
+                    }
+                }
+            }
+        }
+    }
+
+    particles.setThreads(restoreThreads);
+    particles.setChunkSize(restoreChunkSize);
+    particles.setComputeConfiguration(restoreGroupSize, restoreParticlesPerThread);
+    particles.setProcessing(restoreMode);
+
+    const auto fastest = std::min_element(candidates.begin(), candidates.end(),
+        [](const Tuning & a, const Tuning & b) { return a.secondsPerStep < b.secondsPerStep; });
+
+    if (fastest == candidates.end())
+        return Tuning{ restoreMode, restoreThreads, restoreChunkSize, restoreGroupSize, restoreParticlesPerThread, 0.0 };
+
+    // 0 threads (one per logical cpu) counts as the most threads
+    const auto threadsOf = [logical](const Tuning & tuning) { return tuning.threads > 0 ? tuning.threads : logical; };
+
+    auto best = *fastest;
+    for (const auto & candidate : candidates)
+    {
+        if (candidate.secondsPerStep <= fastest->secondsPerStep * (1.0 + tuningTolerance) && threadsOf(candidate) < threadsOf(best))
+            best = candidate;
+    }
+
+    return best;
+}
+
+Tuning autotuneCached(Particles & particles, const std::string & cacheFile, const bool retune, std::ostream & stream)
+{
+    const auto key = hostKey();
+    const auto count = std::to_string(particles.numParticles());
+
+    auto tuning = Tuning{ particles.processing(), particles.threads(), particles.chunkSize(),
+        particles.computeGroupSize(), particles.computeParticlesPerThread(), 0.0 };
+    auto cached = false;
+
+    if (!retune && std::ifstream(cacheFile).good())
+    {
+        // the last entry for host and particle count wins
+        for (const auto & entry : cgutils::loadBenchmarkResults(cacheFile))
+        {
+            auto mode = ProcessingMode();
+            if (entry.get("host_key") != key || entry.get("particles") != count || !Particles::fromString(entry.get("mode"), mode))
+                continue;
+
+            // entries without a compute configuration yield 0, i.e., the defaults
+            tuning = Tuning{ mode, std::atoi(entry.get("omp_threads").c_str()), std::atoi(entry.get("chunk_size").c_str()),
+                std::atoi(entry.get("group_size").c_str()), std::atoi(entry.get("particles_per_thread").c_str()),
+                std::atof(entry.get("ms_per_step").c_str()) * 1e-3 };
+            cached = particles.available(mode);
+        }
+    }
+
+    if (!cached)
+    {
+        stream << "Autotuning processing for " << count << " particles on " << key << std::endl;
+        tuning = autotune(particles, stream);
+
+        auto entry = cgutils::BenchmarkResult();
+        entry.set("host_key", key);
+        entry.set("particles", particles.numParticles());
+        entry.set("mode", Particles::toString(tuning.mode));
+        entry.set("omp_threads", tuning.threads);
+        entry.set("chunk_size", tuning.chunkSize);
+        entry.set("group_size", tuning.groupSize);
+        entry.set("particles_per_thread", tuning.particlesPerThread);
+        entry.set("ms_per_step", tuning.secondsPerStep * 1e3);
+        entry.setEnvironment();
+        entry.append(cacheFile);
+    }
+
+    stream << (cached ? "Cached" : "Tuned") << " processing: " << Particles::toString(tuning.mode)
+        << ", threads " << tuning.threads << ", chunk size " << tuning.chunkSize
+        << ", group size " << tuning.groupSize << ", particles per thread " << tuning.particlesPerThread << std::endl;
+
+    particles.setThreads(tuning.threads);
+    particles.setChunkSize(tuning.chunkSize);
+    particles.setComputeConfiguration(tuning.groupSize, tuning.particlesPerThread);
+    particles.setProcessing(tuning.mode);
+
+    return tuning;
+}
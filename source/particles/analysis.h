@@ -0,0 +1,64 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "particles.h"
+
+
+// For more information on how to write C++ please adhere to:
+// http://cginternals.github.io/guidelines/cpp/index.html
+
+// Kernel analyses of the particle processing, independent of drawing. All expect an
+// initialized particles instance and restore its processing mode and particle count afterwards.
+
+// Measures the sustainable memory bandwidth (STREAM copy and triad, single thread and
+// all threads; measured once and cached) and places each processing mode on a roofline,
+// i.e., its arithmetic intensity and achieved bandwidth versus the bandwidth ceiling.
+void rooflineReport(Particles & particles, std::ostream & stream);
+
+// Compares a step of each available CPU processing mode per integration scheme to the
+// scalar reference kernel from the current state and reports the largest deviation of
+// positions and velocities. The SIMD kernels differ by rounding (fused multiply-add, sum
+// order of the dot product) and the gathered force field samples only.
+void verificationReport(Particles & particles, std::ostream & stream);
+
+// Runs the OpenMP processing modes with 1, 2, 4, ... threads per particle count, once with
+// one thread per physical core and once with SMT siblings packed, and reports speedup,
+// parallel efficiency, and the Karp-Flatt serial fraction. The recommended thread count
+// is the fastest configuration that still achieves the given minimum efficiency.
+void scalingReport(Particles & particles, std::ostream & stream, const std::vector<int> & particleCounts, float minimumEfficiency);
+
+
+// Renders the quad and fluid drawing modes per particle count, once with quads expanded
+// by the geometry shader and once by vertex pulling, and reports the GPU draw time
+// averaged over the given number of frames. Restores drawing mode and particle count.
+void drawingReport(Particles & particles, std::ostream & stream, const std::vector<int> & particleCounts, int frames);
+
+
+// Processing configuration as chosen by the autotuner.
+struct Tuning
+{
+    Particles::ProcessingMode mode;
+    int threads;
+    int chunkSize;
+    int groupSize;          // compute shader work group size
+    int particlesPerThread; // compute shader particles per invocation
+    double secondsPerStep;
+};
+
+// Identifies the host for cached tunings by cpu model, physical cores, logical cpus,
+// and OpenGL renderer and version (which includes the driver version for most vendors).
+std::string hostKey();
+
+// Benchmarks all available processing modes, thread counts, and chunk sizes (for the compute
+// shaders, work group sizes and particles per invocation) for the current particle count and
+// returns the fastest configuration; within 2% of the fastest, fewer threads are preferred.
+// The particles' configuration is not changed.
+Tuning autotune(Particles & particles, std::ostream & stream);
+
+// Looks up the tuning for host and particle count in the given cache file (JSON lines)
+// and runs and appends autotune if there is none or retune is set. The tuning is
+// applied to the particles.
+Tuning autotuneCached(Particles & particles, const std::string & cacheFile, bool retune, std::ostream & stream);
@@ -0,0 +1,446 @@
+
+#include "barneshut.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <immintrin.h>
+
+#pragma warning(push)
+#pragma warning(disable : 4201)
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+#pragma warning(pop)
+
+#include <cgutils/parallel.h>
+
+
+namespace
+{
+
+    const auto leafSize = 64;         // bodies per leaf unless at the finest level, amortizes the walk per leaf
+    const auto maxLevel = 10;         // of the 30-bit Morton codes, 10 bits per axis
+    const auto taskLevel = 2;         // cells built in parallel, i.e., 64 subtrees
+    const auto boundsChunks = 64;     // of the parallel bounding box reduction
+    const auto softening2 = 0.0025f;  // squared softening length, avoids singular close encounters
+
+    // Spreads the lower 10 bits of v to every third bit.
+    std::uint32_t spread(std::uint32_t v)
+    {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    float horizontalSum(__m128 v)
+    {
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(v);
+    }
+
+    // Sum of the softened accelerations of the count point masses on p; a mass at p itself
+    // contributes nothing as its distance is zero.
+    glm::vec3 interact(const glm::vec3 & p, const float * x, const float * y, const float * z,
+        const float * mass, const std::size_t count)
+    {
+        auto k = std::size_t{ 0 };
+
+        auto sse_ax = _mm_setzero_ps();
+        auto sse_ay = _mm_setzero_ps();
+        auto sse_az = _mm_setzero_ps();
+
+#ifdef BUILD_WITH_AVX2
+        const auto avx_px = _mm256_set1_ps(p.x);
+        const auto avx_py = _mm256_set1_ps(p.y);
+        const auto avx_pz = _mm256_set1_ps(p.z);
+        const auto avx_softening2 = _mm256_set1_ps(softening2);
+        const auto avx_05 = _mm256_set1_ps(0.5f);
+        const auto avx_15 = _mm256_set1_ps(1.5f);
+
+        auto avx_ax = _mm256_setzero_ps();
+        auto avx_ay = _mm256_setzero_ps();
+        auto avx_az = _mm256_setzero_ps();
+
+        for (; k + 8 <= count; k += 8)
+        {
+            const auto dx = _mm256_sub_ps(_mm256_loadu_ps(x + k), avx_px);
+            const auto dy = _mm256_sub_ps(_mm256_loadu_ps(y + k), avx_py);
+            const auto dz = _mm256_sub_ps(_mm256_loadu_ps(z + k), avx_pz);
+
+            const auto r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, avx_softening2)));
+
+            // reciprocal square root refined by a Newton-Raphson step
+            auto inv = _mm256_rsqrt_ps(r2);
+            inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(avx_05, r2), _mm256_mul_ps(inv, inv), avx_15));
+            const auto inv3 = _mm256_mul_ps(_mm256_loadu_ps(mass + k), _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+
+            avx_ax = _mm256_fmadd_ps(dx, inv3, avx_ax);
+            avx_ay = _mm256_fmadd_ps(dy, inv3, avx_ay);
+            avx_az = _mm256_fmadd_ps(dz, inv3, avx_az);
+        }
+
+        sse_ax = _mm_add_ps(_mm256_castps256_ps128(avx_ax), _mm256_extractf128_ps(avx_ax, 1));
+        sse_ay = _mm_add_ps(_mm256_castps256_ps128(avx_ay), _mm256_extractf128_ps(avx_ay, 1));
+        sse_az = _mm_add_ps(_mm256_castps256_ps128(avx_az), _mm256_extractf128_ps(avx_az, 1));
+#endif
+
+        const auto sse_px = _mm_set1_ps(p.x);
+        const auto sse_py = _mm_set1_ps(p.y);
+        const auto sse_pz = _mm_set1_ps(p.z);
+        const auto sse_softening2 = _mm_set1_ps(softening2);
+        const auto sse_05 = _mm_set1_ps(0.5f);
+        const auto sse_15 = _mm_set1_ps(1.5f);
+
+        for (; k + 4 <= count; k += 4)
+        {
+            const auto dx = _mm_sub_ps(_mm_loadu_ps(x + k), sse_px);
+            const auto dy = _mm_sub_ps(_mm_loadu_ps(y + k), sse_py);
+            const auto dz = _mm_sub_ps(_mm_loadu_ps(z + k), sse_pz);
+
+            const auto r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), sse_softening2));
+
+            auto inv = _mm_rsqrt_ps(r2);
+            inv = _mm_mul_ps(inv, _mm_sub_ps(sse_15, _mm_mul_ps(_mm_mul_ps(sse_05, r2), _mm_mul_ps(inv, inv))));
+            const auto inv3 = _mm_mul_ps(_mm_loadu_ps(mass + k), _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+
+            sse_ax = _mm_add_ps(_mm_mul_ps(dx, inv3), sse_ax);
+            sse_ay = _mm_add_ps(_mm_mul_ps(dy, inv3), sse_ay);
+            sse_az = _mm_add_ps(_mm_mul_ps(dz, inv3), sse_az);
+        }
+
+        auto a = glm::vec3(horizontalSum(sse_ax), horizontalSum(sse_ay), horizontalSum(sse_az));
+
+        for (; k < count; ++k)
+        {
+            const auto d = glm::vec3(x[k], y[k], z[k]) - p;
+            const auto r2 = glm::dot(d, d) + softening2;
+
+            a += d * (mass[k] / (r2 * std::sqrt(r2)));
+        }
+
+        return a;
+    }
+
+}
+
+
+BarnesHut::BarnesHut()
+: m_theta(0.5f)
+, m_strength(1.f)
+, m_rootSize(0.f)
+, m_count(0)
+{
+}
+
+float BarnesHut::openingAngle() const
+{
+    return m_theta;
+}
+
+void BarnesHut::setOpeningAngle(const float theta)
+{
+    m_theta = std::max(0.f, theta);
+}
+
+float BarnesHut::strength() const
+{
+    return m_strength;
+}
+
+void BarnesHut::setStrength(const float strength)
+{
+    m_strength = strength;
+}
+
+std::size_t BarnesHut::numNodes() const
+{
+    return m_nodes.size();
+}
+
+void BarnesHut::accelerations(const glm::vec4 * positions, const std::int32_t count, glm::vec4 * accelerations, const unsigned int threads)
+{
+    m_count = std::max(0, count);
+    if (m_count == 0)
+        return;
+
+    sortBodies(positions, m_count, threads);
+    buildTree();
+
+    const auto factor = m_strength / static_cast<float>(m_count); // mass of each body
+    const auto numLeaves = static_cast<std::int32_t>(m_leaves.size());
+
+#pragma omp parallel
+    {
+        auto interactions = Interactions();
+
+#pragma omp for schedule(dynamic, 16)
+        for (auto l = 0; l < numLeaves; ++l)
+        {
+            const auto & leaf = m_nodes[m_leaves[l]];
+            gather(leaf, interactions);
+
+            for (auto k = leaf.begin; k < leaf.end; ++k)
+            {
+                const auto a = interact(glm::vec3(m_x[k], m_y[k], m_z[k]), interactions.x.data(), interactions.y.data(),
+                    interactions.z.data(), interactions.mass.data(), interactions.mass.size());
+
+                accelerations[m_order[k]] = glm::vec4(a * factor, 0.f);
+            }
+        }
+    }
+}
+
+void BarnesHut::sortBodies(const glm::vec4 * positions, const std::int32_t count, const unsigned int threads)
+{
+    // bounding box, reduced per chunk as OpenMP 2.0 lacks min and max reductions
+
+    auto minima = std::array<glm::vec3, boundsChunks>();
+    auto maxima = std::array<glm::vec3, boundsChunks>();
+
+#pragma omp parallel for
+    for (auto c = 0; c < boundsChunks; ++c)
+    {
+        const auto begin = static_cast<std::int32_t>(std::int64_t{ count } * c / boundsChunks);
+        const auto end = static_cast<std::int32_t>(std::int64_t{ count } * (c + 1) / boundsChunks);
+
+        auto lo = glm::vec3(std::numeric_limits<float>::max());
+        auto hi = glm::vec3(-std::numeric_limits<float>::max());
+        for (auto i = begin; i < end; ++i)
+        {
+            lo = glm::min(lo, glm::vec3(positions[i]));
+            hi = glm::max(hi, glm::vec3(positions[i]));
+        }
+        minima[c] = lo;
+        maxima[c] = hi;
+    }
+
+    auto lo = minima[0];
+    auto hi = maxima[0];
+    for (auto c = 1; c < boundsChunks; ++c)
+    {
+        lo = glm::min(lo, minima[c]);
+        hi = glm::max(hi, maxima[c]);
+    }
+
+    const auto extent = hi - lo;
+    m_rootSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+
+    // Morton codes of the positions quantized within the bounding cube
+
+    const auto cells = static_cast<float>(1 << maxLevel);
+    const auto scale = cells / m_rootSize;
+
+    m_codes.resize(count);
+    m_order.resize(count);
+
+#pragma omp parallel for
+    for (auto i = 0; i < count; ++i)
+    {
+        const auto q = glm::clamp((glm::vec3(positions[i]) - lo) * scale, glm::vec3(0.f), glm::vec3(cells - 1.f));
+
+        m_codes[i] = (spread(static_cast<std::uint32_t>(q.x)) << 2)
+            | (spread(static_cast<std::uint32_t>(q.y)) << 1) | spread(static_cast<std::uint32_t>(q.z));
+        m_order[i] = static_cast<std::uint32_t>(i);
+    }
+
+    cgutils::radixSort(m_codes.data(), m_order.data(), static_cast<std::size_t>(count), threads);
+
+    m_x.resize(count);
+    m_y.resize(count);
+    m_z.resize(count);
+
+#pragma omp parallel for
+    for (auto k = 0; k < count; ++k)
+    {
+        const auto & p = positions[m_order[k]];
+        m_x[k] = p.x;
+        m_y[k] = p.y;
+        m_z[k] = p.z;
+    }
+}
+
+void BarnesHut::buildTree()
+{
+    const auto cells = 1 << (3 * taskLevel);
+    const auto shift = 3 * (maxLevel - taskLevel);
+
+    m_subtrees.resize(cells);
+
+#pragma omp parallel for schedule(dynamic)
+    for (auto c = 0; c < cells; ++c)
+    {
+        auto & nodes = m_subtrees[c];
+        nodes.clear();
+
+        const auto first = std::lower_bound(m_codes.begin(), m_codes.end(), static_cast<std::uint32_t>(c) << shift);
+        const auto last = std::lower_bound(first, m_codes.end(), static_cast<std::uint32_t>(c + 1) << shift);
+
+        if (first != last)
+            build(nodes, static_cast<std::int32_t>(first - m_codes.begin()), static_cast<std::int32_t>(last - m_codes.begin()), taskLevel);
+    }
+
+    auto numNodes = std::size_t{ 1 + 8 }; // cells above the task level at most
+    for (const auto & subtree : m_subtrees)
+        numNodes += subtree.size();
+
+    m_nodes.clear();
+    m_nodes.reserve(numNodes);
+
+    assemble(0, 0u);
+
+    m_leaves.clear();
+    for (auto i = std::size_t{ 0 }; i < m_nodes.size(); ++i)
+    {
+        if (m_nodes[i].end > m_nodes[i].begin)
+            m_leaves.push_back(static_cast<std::int32_t>(i));
+    }
+}
+
+void BarnesHut::build(std::vector<Node> & nodes, const std::int32_t begin, const std::int32_t end, const int level) const
+{
+    const auto index = nodes.size();
+    nodes.push_back(Node());
+
+    auto node = Node();
+    auto mass = glm::vec4(0.f);
+
+    if (end - begin <= leafSize || level == maxLevel)
+    {
+        for (auto k = begin; k < end; ++k)
+            mass += glm::vec4(m_x[k], m_y[k], m_z[k], 1.f);
+
+        node.begin = begin;
+        node.end = end;
+    }
+    else
+    {
+        // the bodies of each child cell share the code bits above shift and are contiguous
+        const auto shift = 3 * (maxLevel - level - 1);
+        const auto below = (1u << shift) - 1u;
+
+        for (auto first = begin; first < end; )
+        {
+            const auto last = static_cast<std::int32_t>(std::upper_bound(m_codes.begin() + first,
+                m_codes.begin() + end, m_codes[first] | below) - m_codes.begin());
+
+            const auto child = nodes.size();
+            build(nodes, first, last, level + 1);
+
+            const auto & c = nodes[child].mass;
+            mass += glm::vec4(glm::vec3(c) * c.w, c.w);
+
+            first = last;
+        }
+
+        node.begin = 0;
+        node.end = 0;
+    }
+
+    node.mass = glm::vec4(glm::vec3(mass) / mass.w, mass.w);
+    node.size = m_rootSize / static_cast<float>(1 << level);
+    node.next = static_cast<std::int32_t>(nodes.size());
+
+    nodes[index] = node;
+}
+
+bool BarnesHut::assemble(const int level, const std::uint32_t cell)
+{
+    if (level == taskLevel)
+    {
+        const auto & subtree = m_subtrees[cell];
+        if (subtree.empty())
+            return false;
+
+        const auto offset = static_cast<std::int32_t>(m_nodes.size());
+        for (auto node : subtree)
+        {
+            node.next += offset;
+            m_nodes.push_back(node);
+        }
+        return true;
+    }
+
+    const auto index = m_nodes.size();
+    m_nodes.push_back(Node());
+
+    auto mass = glm::vec4(0.f);
+    for (auto octant = 0u; octant < 8u; ++octant)
+    {
+        const auto child = m_nodes.size();
+        if (!assemble(level + 1, cell * 8u + octant))
+            continue;
+
+        const auto & c = m_nodes[child].mass;
+        mass += glm::vec4(glm::vec3(c) * c.w, c.w);
+    }
+
+    if (mass.w == 0.f)
+    {
+        m_nodes.pop_back();
+        return false;
+    }
+
+    auto & node = m_nodes[index];
+    node.mass = glm::vec4(glm::vec3(mass) / mass.w, mass.w);
+    node.size = m_rootSize / static_cast<float>(1 << level);
+    node.next = static_cast<std::int32_t>(m_nodes.size());
+    node.begin = 0;
+    node.end = 0;
+
+    return true;
+}
+
+void BarnesHut::gather(const Node & leaf, Interactions & interactions) const
+{
+    interactions.x.clear();
+    interactions.y.clear();
+    interactions.z.clear();
+    interactions.mass.clear();
+
+    // bounding box of the leaf's bodies, the opening criterion has to hold for all of them
+
+    auto lo = glm::vec3(std::numeric_limits<float>::max());
+    auto hi = glm::vec3(-std::numeric_limits<float>::max());
+    for (auto k = leaf.begin; k < leaf.end; ++k)
+    {
+        const auto p = glm::vec3(m_x[k], m_y[k], m_z[k]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+
+    const auto theta2 = m_theta * m_theta;
+    const auto numNodes = static_cast<std::int32_t>(m_nodes.size());
+
+    for (auto i = 0; i < numNodes; )
+    {
+        const auto & node = m_nodes[i];
+
+        const auto center = glm::vec3(node.mass);
+        const auto d = glm::max(glm::max(lo - center, center - hi), glm::vec3(0.f));
+
+        if (node.size * node.size < theta2 * glm::dot(d, d))
+        {
+            interactions.x.push_back(center.x);
+            interactions.y.push_back(center.y);
+            interactions.z.push_back(center.z);
+            interactions.mass.push_back(node.mass.w);
+            i = node.next;
+        }
+        else if (node.end > node.begin)
+        {
+            interactions.x.insert(interactions.x.end(), m_x.begin() + node.begin, m_x.begin() + node.end);
+            interactions.y.insert(interactions.y.end(), m_y.begin() + node.begin, m_y.begin() + node.end);
+            interactions.z.insert(interactions.z.end(), m_z.begin() + node.begin, m_z.begin() + node.end);
+            interactions.mass.insert(interactions.mass.end(), node.end - node.begin, 1.f);
+            i = node.next;
+        }
+        else
+            ++i; // open the cell, its first child follows
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "allocator.h"
+
+#pragma warning(push)
+#pragma warning(disable : 4201)
+#include <glm/vec4.hpp>
+#pragma warning(pop)
+
+
+// For more information on how to write C++ please adhere to:
+// http://cginternals.github.io/guidelines/cpp/index.html
+
+// Mutual attraction of equal mass bodies by a Barnes-Hut approximation in O(N log N). The
+// octree is rebuilt from scratch for every evaluation: the bodies are sorted by the Morton
+// code of their position within the bounding cube, so every cell covers a contiguous range
+// of sorted bodies, and the subtrees below the top levels are built in parallel. Nodes are
+// stored depth first with the index past their subtree, so traversals need no stack. The
+// tree is walked once per leaf instead of per body: a cell that appears smaller than the
+// opening angle from anywhere within the leaf's bounding box is approximated by its center
+// of mass, otherwise it is opened or, for leaves, its bodies are taken directly. The
+// resulting interaction list is shared by all bodies of the leaf and summed up in SIMD.
+class BarnesHut
+{
+public:
+    BarnesHut();
+
+    // Cell edge length over distance below which a cell is approximated (0 sums up all pairs).
+    float openingAngle() const;
+    void setOpeningAngle(float theta);
+
+    // Gravitational constant times the total mass of all bodies, i.e., independent of their number.
+    float strength() const;
+    void setStrength(float strength);
+
+    // Writes the acceleration of each of the first count positions into accelerations
+    // (w is zeroed); threads is used for the sort (0 for hardware concurrency).
+    void accelerations(const glm::vec4 * positions, std::int32_t count, glm::vec4 * accelerations, unsigned int threads = 0);
+
+    std::size_t numNodes() const;
+
+protected:
+    struct Node
+    {
+        glm::vec4 mass;     // center of mass and number of bodies
+        float size;         // edge length of the cell
+        std::int32_t next;  // index past the subtree
+        std::int32_t begin; // sorted bodies of leaves, empty for inner nodes
+        std::int32_t end;
+    };
+
+    // Point masses acting on the bodies of a leaf, split by component.
+    struct Interactions
+    {
+        std::vector<float, aligned_allocator<float, 32>> x;
+        std::vector<float, aligned_allocator<float, 32>> y;
+        std::vector<float, aligned_allocator<float, 32>> z;
+        std::vector<float, aligned_allocator<float, 32>> mass;
+    };
+
+    void sortBodies(const glm::vec4 * positions, std::int32_t count, unsigned int threads);
+    void buildTree();
+    void build(std::vector<Node> & nodes, std::int32_t begin, std::int32_t end, int level) const;
+    bool assemble(int level, std::uint32_t cell);
+    void gather(const Node & leaf, Interactions & interactions) const;
+
+protected:
+    float m_theta;
+    float m_strength;
+
+    float m_rootSize;
+    std::int32_t m_count;
+
+    std::vector<std::uint32_t> m_codes; // sorted Morton codes
+    std::vector<std::uint32_t> m_order; // index of the body per sorted code
+
+    // sorted positions, split by component for the leaf interactions
+    std::vector<float, aligned_allocator<float, 32>> m_x;
+    std::vector<float, aligned_allocator<float, 32>> m_y;
+    std::vector<float, aligned_allocator<float, 32>> m_z;
+
+    std::vector<std::vector<Node>> m_subtrees; // per cell of the top levels, indices relative
+    std::vector<Node> m_nodes;
+    std::vector<std::int32_t> m_leaves; // node indices
+};
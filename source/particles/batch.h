@@ -0,0 +1,206 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <immintrin.h>
+
+
+// For more information on how to write C++ please adhere to:
+// http://cginternals.github.io/guidelines/cpp/index.html
+
+// Thin wrappers of SIMD registers, so a kernel is written once as a template and compiled
+// for every instruction set. The scalar batch of four lanes is the reference; the SSE4.1,
+// AVX2 (with FMA), and AVX-512F batches map each operation to a few intrinsics. Besides
+// lane-wise arithmetic, comparison, and selection, a batch supports operations on groups
+// of four lanes, i.e., on the glm::vec4 of a particle each.
+namespace simd
+{
+
+// Instruction sets, the third parameter of batch.
+struct Scalar {};
+struct SSE41 {};
+struct AVX2 {};
+struct AVX512 {};
+
+
+template <typename T, std::size_t N, typename ISA = Scalar>
+class batch; // specialized per instruction set below
+
+
+// The reference, spelled out per lane as compilers do not reliably unroll short loops.
+template <>
+class batch<float, 4, Scalar>
+{
+public:
+    static const std::size_t size = 4;
+    using mask = std::array<bool, 4>;
+
+public:
+    batch() = default;
+    batch(float value) : m_x(value), m_y(value), m_z(value), m_w(value) { } // broadcast
+    batch(float x, float y, float z, float w) : m_x(x), m_y(y), m_z(z), m_w(w) { }
+
+    // Data is expected to be aligned to the batch size in bytes.
+    static batch load(const float * data) { return batch(data[0], data[1], data[2], data[3]); }
+    void store(float * data) const { data[0] = m_x; data[1] = m_y; data[2] = m_z; data[3] = m_w; }
+
+    // The given values in each group of four lanes.
+    static batch repeat(float x, float y, float z, float w) { return batch(x, y, z, w); }
+
+    // The given lane of each group of four lanes, broadcast within its group.
+    template <std::size_t Lane>
+    batch splat() const
+    {
+        const float values[4] = { m_x, m_y, m_z, m_w };
+        return batch(values[Lane]);
+    }
+
+    friend batch operator+(const batch & a, const batch & b) { return batch(a.m_x + b.m_x, a.m_y + b.m_y, a.m_z + b.m_z, a.m_w + b.m_w); }
+    friend batch operator-(const batch & a, const batch & b) { return batch(a.m_x - b.m_x, a.m_y - b.m_y, a.m_z - b.m_z, a.m_w - b.m_w); }
+    friend batch operator*(const batch & a, const batch & b) { return batch(a.m_x * b.m_x, a.m_y * b.m_y, a.m_z * b.m_z, a.m_w * b.m_w); }
+
+    // a * b + c
+    friend batch fma(const batch & a, const batch & b, const batch & c) { return a * b + c; }
+
+    // Dot product of the first three lanes of each group, broadcast within its group.
+    friend batch dot3(const batch & a, const batch & b) { return batch(a.m_x * b.m_x + a.m_y * b.m_y + a.m_z * b.m_z); }
+
+    friend mask operator<(const batch & a, const batch & b) { return mask{ { a.m_x < b.m_x, a.m_y < b.m_y, a.m_z < b.m_z, a.m_w < b.m_w } }; }
+
+    // Lanes of a where the mask is set, of b elsewhere.
+    friend batch select(const mask & m, const batch & a, const batch & b)
+    {
+        return batch(m[0] ? a.m_x : b.m_x, m[1] ? a.m_y : b.m_y, m[2] ? a.m_z : b.m_z, m[3] ? a.m_w : b.m_w);
+    }
+
+protected:
+    float m_x;
+    float m_y;
+    float m_z;
+    float m_w;
+};
+
+
+template <>
+class batch<float, 4, SSE41>
+{
+public:
+    static const std::size_t size = 4;
+    using mask = __m128;
+
+public:
+    batch() = default;
+    batch(float value) : m_value(_mm_set1_ps(value)) { }
+    explicit batch(__m128 value) : m_value(value) { }
+
+    static batch load(const float * data) { return batch(_mm_load_ps(data)); }
+    void store(float * data) const { _mm_store_ps(data, m_value); }
+
+    static batch repeat(float x, float y, float z, float w) { return batch(_mm_setr_ps(x, y, z, w)); }
+
+    template <std::size_t Lane>
+    batch splat() const { return batch(_mm_shuffle_ps(m_value, m_value, _MM_SHUFFLE(Lane, Lane, Lane, Lane))); }
+
+    friend batch operator+(const batch & a, const batch & b) { return batch(_mm_add_ps(a.m_value, b.m_value)); }
+    friend batch operator-(const batch & a, const batch & b) { return batch(_mm_sub_ps(a.m_value, b.m_value)); }
+    friend batch operator*(const batch & a, const batch & b) { return batch(_mm_mul_ps(a.m_value, b.m_value)); }
+
+    // SSE4.1 has no fused multiply-add
+    friend batch fma(const batch & a, const batch & b, const batch & c) { return batch(_mm_add_ps(_mm_mul_ps(a.m_value, b.m_value), c.m_value)); }
+
+    friend batch dot3(const batch & a, const batch & b) { return batch(_mm_dp_ps(a.m_value, b.m_value, 0x7f)); }
+
+    friend mask operator<(const batch & a, const batch & b) { return _mm_cmplt_ps(a.m_value, b.m_value); }
+    friend batch select(const mask & m, const batch & a, const batch & b) { return batch(_mm_blendv_ps(b.m_value, a.m_value, m)); }
+
+protected:
+    __m128 m_value;
+};
+
+
+#ifdef BUILD_WITH_AVX2
+
+template <>
+class batch<float, 8, AVX2>
+{
+public:
+    static const std::size_t size = 8;
+    using mask = __m256;
+
+public:
+    batch() = default;
+    batch(float value) : m_value(_mm256_set1_ps(value)) { }
+    explicit batch(__m256 value) : m_value(value) { }
+
+    static batch load(const float * data) { return batch(_mm256_load_ps(data)); }
+    void store(float * data) const { _mm256_store_ps(data, m_value); }
+
+    static batch repeat(float x, float y, float z, float w) { return batch(_mm256_setr_ps(x, y, z, w, x, y, z, w)); }
+
+    template <std::size_t Lane>
+    batch splat() const { return batch(_mm256_permute_ps(m_value, _MM_SHUFFLE(Lane, Lane, Lane, Lane))); }
+
+    friend batch operator+(const batch & a, const batch & b) { return batch(_mm256_add_ps(a.m_value, b.m_value)); }
+    friend batch operator-(const batch & a, const batch & b) { return batch(_mm256_sub_ps(a.m_value, b.m_value)); }
+    friend batch operator*(const batch & a, const batch & b) { return batch(_mm256_mul_ps(a.m_value, b.m_value)); }
+
+    friend batch fma(const batch & a, const batch & b, const batch & c) { return batch(_mm256_fmadd_ps(a.m_value, b.m_value, c.m_value)); }
+
+    friend batch dot3(const batch & a, const batch & b) { return batch(_mm256_dp_ps(a.m_value, b.m_value, 0x7f)); }
+
+    friend mask operator<(const batch & a, const batch & b) { return _mm256_cmp_ps(a.m_value, b.m_value, _CMP_LT_OQ); }
+    friend batch select(const mask & m, const batch & a, const batch & b) { return batch(_mm256_blendv_ps(b.m_value, a.m_value, m)); }
+
+protected:
+    __m256 m_value;
+};
+
+#endif
+
+
+#ifdef BUILD_WITH_AVX512
+
+template <>
+class batch<float, 16, AVX512>
+{
+public:
+    static const std::size_t size = 16;
+    using mask = __mmask16;
+
+public:
+    batch() = default;
+    batch(float value) : m_value(_mm512_set1_ps(value)) { }
+    explicit batch(__m512 value) : m_value(value) { }
+
+    static batch load(const float * data) { return batch(_mm512_load_ps(data)); }
+    void store(float * data) const { _mm512_store_ps(data, m_value); }
+
+    static batch repeat(float x, float y, float z, float w) { return batch(_mm512_setr4_ps(x, y, z, w)); }
+
+    template <std::size_t Lane>
+    batch splat() const { return batch(_mm512_shuffle_ps(m_value, m_value, _MM_SHUFFLE(Lane, Lane, Lane, Lane))); }
+
+    friend batch operator+(const batch & a, const batch & b) { return batch(_mm512_add_ps(a.m_value, b.m_value)); }
+    friend batch operator-(const batch & a, const batch & b) { return batch(_mm512_sub_ps(a.m_value, b.m_value)); }
+    friend batch operator*(const batch & a, const batch & b) { return batch(_mm512_mul_ps(a.m_value, b.m_value)); }
+
+    friend batch fma(const batch & a, const batch & b, const batch & c) { return batch(_mm512_fmadd_ps(a.m_value, b.m_value, c.m_value)); }
+
+    // there is no dot product instruction, sum the products within each group instead
+    friend batch dot3(const batch & a, const batch & b)
+    {
+        const auto p = a * b;
+        return p.splat<0>() + p.splat<1>() + p.splat<2>();
+    }
+
+    friend mask operator<(const batch & a, const batch & b) { return _mm512_cmp_ps_mask(a.m_value, b.m_value, _CMP_LT_OQ); }
+    friend batch select(const mask & m, const batch & a, const batch & b) { return batch(_mm512_mask_blend_ps(m, b.m_value, a.m_value)); }
+
+protected:
+    __m512 m_value;
+};
+
+#endif
+
+} // namespace simd
@@ -0,0 +1,572 @@
+
+#include "colliders.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include <immintrin.h>
+
+#pragma warning(push)
+#pragma warning(disable : 4201)
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#pragma warning(pop)
+
+#include <cgutils/common.h>
+
+
+namespace
+{
+
+    const auto damping = 1.f - 0.3333f; // of velocity on impact, as at the ground plane
+    const auto gridCells = 16;          // per axis of the broadphase grid
+    const auto maximumDistance = std::numeric_limits<float>::max();
+    const auto minimumNormalLength = 1e-6f; // of plane normals, shorter ones have no direction
+
+    int countTrailingZeros(const std::uint64_t bits)
+    {
+        auto count = 0;
+        while (!((bits >> count) & 1u))
+            ++count;
+        return count;
+    }
+
+    __m128 length(const __m128 x, const __m128 y, const __m128 z)
+    {
+        return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    }
+
+    // Normalizes (x, y, z) by the given length, zero vectors stay zero.
+    void normalize(__m128 & x, __m128 & y, __m128 & z, const __m128 length)
+    {
+        const auto inverse = _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(length, _mm_set1_ps(1e-12f)));
+        x = _mm_mul_ps(x, inverse);
+        y = _mm_mul_ps(y, inverse);
+        z = _mm_mul_ps(z, inverse);
+    }
+
+    // ±1 by the sign of v.
+    __m128 sign(const __m128 v)
+    {
+        return _mm_or_ps(_mm_set1_ps(1.f), _mm_and_ps(v, _mm_set1_ps(-0.f)));
+    }
+
+    // Trilinear distance and its gradient within a grid; returns false outside the grid.
+    bool sample(const std::vector<float> & distances, const glm::ivec3 & resolution, const glm::vec3 & origin,
+        const float spacing, const glm::vec3 & position, float & distance, glm::vec3 & gradient)
+    {
+        const auto g = (position - origin) / spacing;
+        const auto last = glm::vec3(resolution - 1);
+        if (g.x < 0.f || g.y < 0.f || g.z < 0.f || g.x > last.x || g.y > last.y || g.z > last.z)
+            return false;
+
+        const auto i = glm::min(glm::ivec3(g), glm::max(resolution - 2, glm::ivec3(0)));
+        const auto f = g - glm::vec3(i);
+
+        const auto sx = 1;
+        const auto sy = resolution.x;
+        const auto sz = resolution.x * resolution.y;
+        const auto * c = distances.data() + i.x + i.y * sy + i.z * sz;
+
+        const auto c000 = c[0],       c100 = c[sx];
+        const auto c010 = c[sy],      c110 = c[sx + sy];
+        const auto c001 = c[sz],      c101 = c[sx + sz];
+        const auto c011 = c[sy + sz], c111 = c[sx + sy + sz];
+
+        const auto x00 = c000 + (c100 - c000) * f.x;
+        const auto x10 = c010 + (c110 - c010) * f.x;
+        const auto x01 = c001 + (c101 - c001) * f.x;
+        const auto x11 = c011 + (c111 - c011) * f.x;
+        const auto y0 = x00 + (x10 - x00) * f.y;
+        const auto y1 = x01 + (x11 - x01) * f.y;
+
+        distance = y0 + (y1 - y0) * f.z;
+
+        const auto dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * f.y;
+        const auto dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * f.y;
+        gradient.x = dx0 + (dx1 - dx0) * f.z;
+        gradient.y = (x10 - x00) + ((x11 - x01) - (x10 - x00)) * f.z;
+        gradient.z = y1 - y0;
+
+        return true;
+    }
+
+}
+
+
+Colliders::Colliders()
+: m_unbounded(0u)
+, m_gridOrigin(0.f)
+, m_gridScale(0.f)
+{
+}
+
+void Colliders::clear()
+{
+    m_colliders.clear();
+    m_fields.clear();
+    buildBroadphase();
+}
+
+bool Colliders::empty() const
+{
+    return m_colliders.empty();
+}
+
+std::size_t Colliders::size() const
+{
+    return m_colliders.size();
+}
+
+bool Colliders::addSphere(const glm::vec3 & center, const float radius)
+{
+    if (!(radius >= 0.f))
+    {
+        std::cerr << "Invalid sphere radius " << radius << std::endl;
+        return false;
+    }
+
+    auto collider = Collider();
+    collider.shape = Shape::Sphere;
+    collider.a = center;
+    collider.radius = radius;
+
+    return add(collider);
+}
+
+bool Colliders::addBox(const glm::vec3 & center, const glm::vec3 & halfExtents)
+{
+    auto collider = Collider();
+    collider.shape = Shape::Box;
+    collider.a = center;
+    collider.b = glm::abs(halfExtents);
+
+    return add(collider);
+}
+
+bool Colliders::addCapsule(const glm::vec3 & a, const glm::vec3 & b, const float radius)
+{
+    if (!(radius >= 0.f))
+    {
+        std::cerr << "Invalid capsule radius " << radius << std::endl;
+        return false;
+    }
+
+    auto collider = Collider();
+    collider.shape = Shape::Capsule;
+    collider.a = a;
+    collider.b = b;
+    collider.radius = radius;
+
+    return add(collider);
+}
+
+bool Colliders::addPlane(const glm::vec3 & normal, const float offset)
+{
+    const auto length = glm::length(normal);
+    if (!(length > minimumNormalLength))
+    {
+        std::cerr << "Invalid plane normal of length " << length << std::endl;
+        return false;
+    }
+
+    auto collider = Collider();
+    collider.shape = Shape::Plane;
+    collider.a = normal / length;
+    collider.radius = offset / length;
+
+    return add(collider);
+}
+
+bool Colliders::addField(const std::vector<float> & distances, const glm::ivec3 & resolution, const glm::vec3 & origin, const float spacing)
+{
+    if (glm::any(glm::lessThan(resolution, glm::ivec3(2))) || spacing <= 0.f
+        || distances.size() != static_cast<std::size_t>(resolution.x) * resolution.y * resolution.z)
+    {
+        std::cerr << "Invalid signed distance field of " << distances.size() << " samples" << std::endl;
+        return false;
+    }
+
+    auto collider = Collider();
+    collider.shape = Shape::Field;
+    collider.a = origin;
+    collider.b = glm::vec3(resolution);
+    collider.radius = spacing;
+    collider.field = m_fields.size();
+
+    if (!add(collider))
+        return false;
+
+    m_fields.push_back(distances);
+    return true;
+}
+
+bool Colliders::addField(const std::string & rawFile, const glm::ivec3 & resolution, const glm::vec3 & origin, const float spacing)
+{
+    const auto raw = cgutils::rawFromFile(rawFile.c_str());
+
+    auto distances = std::vector<float>(raw.size() / sizeof(float));
+    std::copy(raw.begin(), raw.begin() + distances.size() * sizeof(float), reinterpret_cast<char *>(distances.data()));
+
+    return addField(distances, resolution, origin, spacing);
+}
+
+bool Colliders::load(const std::string & filePath)
+{
+    auto file = std::ifstream(filePath);
+    if (!file)
+    {
+        std::cerr << "Cannot open collider file " << filePath << std::endl;
+        return false;
+    }
+
+    auto line = std::string();
+    auto number = 0;
+    auto success = true;
+
+    while (std::getline(file, line))
+    {
+        ++number;
+        line = line.substr(0, line.find('#'));
+
+        auto stream = std::istringstream(line);
+        auto shape = std::string();
+        if (!(stream >> shape))
+            continue;
+
+        auto a = glm::vec3();
+        auto b = glm::vec3();
+        auto radius = 0.f;
+        auto added = false;
+
+        if (shape == "sphere" && stream >> a.x >> a.y >> a.z >> radius)
+            added = addSphere(a, radius);
+        else if (shape == "box" && stream >> a.x >> a.y >> a.z >> b.x >> b.y >> b.z)
+            added = addBox(a, b);
+        else if (shape == "capsule" && stream >> a.x >> a.y >> a.z >> b.x >> b.y >> b.z >> radius)
+            added = addCapsule(a, b, radius);
+        else if (shape == "plane" && stream >> a.x >> a.y >> a.z >> radius)
+            added = addPlane(a, radius);
+        else if (shape == "field")
+        {
+            auto rawFile = std::string();
+            auto resolution = glm::ivec3();
+            if (stream >> rawFile >> resolution.x >> resolution.y >> resolution.z >> a.x >> a.y >> a.z >> radius)
+                added = addField(rawFile, resolution, a, radius);
+        }
+
+        if (!added)
+        {
+            std::cerr << filePath << "(" << number << "): invalid collider '" << line << "'" << std::endl;
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+bool Colliders::add(const Collider & collider)
+{
+    if (m_colliders.size() == maxColliders)
+    {
+        std::cerr << "More than " << maxColliders << " colliders are not supported" << std::endl;
+        return false;
+    }
+
+    m_colliders.push_back(collider);
+    buildBroadphase();
+
+    return true;
+}
+
+void Colliders::buildBroadphase()
+{
+    m_unbounded = 0u;
+    m_cells.clear();
+
+    // bounding boxes of the bounded colliders
+
+    auto minima = std::vector<glm::vec3>(m_colliders.size());
+    auto maxima = std::vector<glm::vec3>(m_colliders.size());
+
+    auto lo = glm::vec3(maximumDistance);
+    auto hi = glm::vec3(-maximumDistance);
+    auto bounded = false;
+
+    for (auto i = std::size_t{ 0 }; i < m_colliders.size(); ++i)
+    {
+        const auto & c = m_colliders[i];
+        switch (c.shape)
+        {
+        case Shape::Sphere:
+            minima[i] = c.a - c.radius;
+            maxima[i] = c.a + c.radius;
+            break;
+        case Shape::Box:
+            minima[i] = c.a - c.b;
+            maxima[i] = c.a + c.b;
+            break;
+        case Shape::Capsule:
+            minima[i] = glm::min(c.a, c.b) - c.radius;
+            maxima[i] = glm::max(c.a, c.b) + c.radius;
+            break;
+        case Shape::Field:
+            minima[i] = c.a;
+            maxima[i] = c.a + (c.b - 1.f) * c.radius;
+            break;
+        case Shape::Plane:
+        default:
+            m_unbounded |= std::uint64_t{ 1 } << i;
+            continue;
+        }
+
+        lo = glm::min(lo, minima[i]);
+        hi = glm::max(hi, maxima[i]);
+        bounded = true;
+    }
+
+    if (!bounded)
+        return;
+
+    // cells of the grid over all bounded colliders mark the colliders their box overlaps
+
+    m_gridOrigin = lo;
+    m_gridScale = static_cast<float>(gridCells) / glm::max(hi - lo, glm::vec3(1e-6f));
+    m_cells.assign(gridCells * gridCells * gridCells, m_unbounded);
+
+    for (auto i = std::size_t{ 0 }; i < m_colliders.size(); ++i)
+    {
+        if (m_colliders[i].shape == Shape::Plane)
+            continue;
+
+        const auto first = glm::clamp(glm::ivec3((minima[i] - lo) * m_gridScale), glm::ivec3(0), glm::ivec3(gridCells - 1));
+        const auto last = glm::clamp(glm::ivec3((maxima[i] - lo) * m_gridScale), glm::ivec3(0), glm::ivec3(gridCells - 1));
+
+        for (auto z = first.z; z <= last.z; ++z)
+            for (auto y = first.y; y <= last.y; ++y)
+                for (auto x = first.x; x <= last.x; ++x)
+                    m_cells[(z * gridCells + y) * gridCells + x] |= std::uint64_t{ 1 } << i;
+    }
+}
+
+std::uint64_t Colliders::mask(const glm::vec4 & position) const
+{
+    if (m_cells.empty())
+        return m_unbounded;
+
+    const auto g = (glm::vec3(position) - m_gridOrigin) * m_gridScale;
+    if (g.x < 0.f || g.y < 0.f || g.z < 0.f || g.x >= gridCells || g.y >= gridCells || g.z >= gridCells)
+        return m_unbounded;
+
+    const auto cell = glm::ivec3(g);
+    return m_cells[(cell.z * gridCells + cell.y) * gridCells + cell.x];
+}
+
+void Colliders::collide(glm::vec4 * positions, glm::vec4 * velocities, const std::int32_t count, const bool parallel) const
+{
+    if (m_colliders.empty())
+        return;
+
+    const auto sse_0 = _mm_setzero_ps();
+    const auto sse_1 = _mm_set1_ps(1.f);
+    const auto sse_2 = _mm_set1_ps(2.f);
+    const auto sse_damping = _mm_set1_ps(damping);
+
+    const auto batches = (count + 3) / 4;
+
+#pragma omp parallel for schedule(runtime) if(parallel)
+    for (auto batch = 0; batch < batches; ++batch)
+    {
+        const auto first = batch * 4;
+        const auto lanes = std::min(4, count - first);
+
+        // broadphase, the batch evaluates the union of its particles' colliders
+
+        std::uint64_t masks[4] = { 0u, 0u, 0u, 0u };
+        auto colliders = std::uint64_t{ 0 };
+        for (auto lane = 0; lane < lanes; ++lane)
+        {
+            masks[lane] = mask(positions[first + lane]);
+            colliders |= masks[lane];
+        }
+
+        if (!colliders)
+            continue;
+
+        // transpose four particles into x, y, z, and w vectors
+
+        auto px = _mm_load_ps(&positions[first].x);
+        auto py = _mm_load_ps(&positions[first + std::min(1, lanes - 1)].x);
+        auto pz = _mm_load_ps(&positions[first + std::min(2, lanes - 1)].x);
+        auto pw = _mm_load_ps(&positions[first + std::min(3, lanes - 1)].x);
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+        auto vx = _mm_load_ps(&velocities[first].x);
+        auto vy = _mm_load_ps(&velocities[first + std::min(1, lanes - 1)].x);
+        auto vz = _mm_load_ps(&velocities[first + std::min(2, lanes - 1)].x);
+        auto vw = _mm_load_ps(&velocities[first + std::min(3, lanes - 1)].x);
+        _MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+
+        auto touched = 0;
+
+        while (colliders)
+        {
+            const auto index = countTrailingZeros(colliders);
+            colliders &= colliders - 1u;
+
+            const auto & c = m_colliders[index];
+            const auto bit = std::uint64_t{ 1 } << index;
+            const auto lanesMask = _mm_castsi128_ps(_mm_set_epi32(masks[3] & bit ? -1 : 0, masks[2] & bit ? -1 : 0,
+                masks[1] & bit ? -1 : 0, masks[0] & bit ? -1 : 0));
+
+            // signed distance and outward normal
+
+            auto d = sse_0;
+            auto nx = sse_0;
+            auto ny = sse_0;
+            auto nz = sse_0;
+
+            switch (c.shape)
+            {
+            case Shape::Sphere:
+            {
+                nx = _mm_sub_ps(px, _mm_set1_ps(c.a.x));
+                ny = _mm_sub_ps(py, _mm_set1_ps(c.a.y));
+                nz = _mm_sub_ps(pz, _mm_set1_ps(c.a.z));
+
+                const auto l = length(nx, ny, nz);
+                d = _mm_sub_ps(l, _mm_set1_ps(c.radius));
+                normalize(nx, ny, nz, l);
+                break;
+            }
+            case Shape::Box:
+            {
+                // inside iff the largest per axis distance q is negative, the normal is its axis
+                const auto dx = _mm_sub_ps(px, _mm_set1_ps(c.a.x));
+                const auto dy = _mm_sub_ps(py, _mm_set1_ps(c.a.y));
+                const auto dz = _mm_sub_ps(pz, _mm_set1_ps(c.a.z));
+                const auto abs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+                const auto qx = _mm_sub_ps(_mm_and_ps(dx, abs), _mm_set1_ps(c.b.x));
+                const auto qy = _mm_sub_ps(_mm_and_ps(dy, abs), _mm_set1_ps(c.b.y));
+                const auto qz = _mm_sub_ps(_mm_and_ps(dz, abs), _mm_set1_ps(c.b.z));
+
+                d = _mm_max_ps(qx, _mm_max_ps(qy, qz));
+
+                const auto isX = _mm_cmpeq_ps(qx, d);
+                const auto isY = _mm_andnot_ps(isX, _mm_cmpeq_ps(qy, d));
+                const auto isZ = _mm_andnot_ps(_mm_or_ps(isX, isY), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+                nx = _mm_and_ps(isX, sign(dx));
+                ny = _mm_and_ps(isY, sign(dy));
+                nz = _mm_and_ps(isZ, sign(dz));
+                break;
+            }
+            case Shape::Capsule:
+            {
+                const auto ba = c.b - c.a;
+                const auto inverse = 1.f / glm::max(glm::dot(ba, ba), 1e-12f);
+
+                const auto ax = _mm_sub_ps(px, _mm_set1_ps(c.a.x));
+                const auto ay = _mm_sub_ps(py, _mm_set1_ps(c.a.y));
+                const auto az = _mm_sub_ps(pz, _mm_set1_ps(c.a.z));
+
+                const auto bax = _mm_set1_ps(ba.x);
+                const auto bay = _mm_set1_ps(ba.y);
+                const auto baz = _mm_set1_ps(ba.z);
+
+                auto h = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bax), _mm_mul_ps(ay, bay)), _mm_mul_ps(az, baz)), _mm_set1_ps(inverse));
+                h = _mm_min_ps(_mm_max_ps(h, sse_0), sse_1);
+
+                nx = _mm_sub_ps(ax, _mm_mul_ps(bax, h));
+                ny = _mm_sub_ps(ay, _mm_mul_ps(bay, h));
+                nz = _mm_sub_ps(az, _mm_mul_ps(baz, h));
+
+                const auto l = length(nx, ny, nz);
+                d = _mm_sub_ps(l, _mm_set1_ps(c.radius));
+                normalize(nx, ny, nz, l);
+                break;
+            }
+            case Shape::Plane:
+            {
+                nx = _mm_set1_ps(c.a.x);
+                ny = _mm_set1_ps(c.a.y);
+                nz = _mm_set1_ps(c.a.z);
+                d = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, nx), _mm_mul_ps(py, ny)), _mm_mul_ps(pz, nz)), _mm_set1_ps(c.radius));
+                break;
+            }
+            case Shape::Field:
+            {
+                // no gather in SSE, the grid is sampled per lane
+                alignas(16) float x[4], y[4], z[4], distances[4], gx[4], gy[4], gz[4];
+                _mm_store_ps(x, px);
+                _mm_store_ps(y, py);
+                _mm_store_ps(z, pz);
+
+                for (auto lane = 0; lane < 4; ++lane)
+                {
+                    auto gradient = glm::vec3(0.f);
+                    distances[lane] = maximumDistance;
+                    sample(m_fields[c.field], glm::ivec3(c.b), c.a, c.radius, glm::vec3(x[lane], y[lane], z[lane]), distances[lane], gradient);
+
+                    gx[lane] = gradient.x;
+                    gy[lane] = gradient.y;
+                    gz[lane] = gradient.z;
+                }
+
+                d = _mm_load_ps(distances);
+                nx = _mm_load_ps(gx);
+                ny = _mm_load_ps(gy);
+                nz = _mm_load_ps(gz);
+                normalize(nx, ny, nz, length(nx, ny, nz));
+                break;
+            }
+            default:
+                break; // no hit at distance zero
+            }
+
+            const auto inside = _mm_and_ps(_mm_cmplt_ps(d, sse_0), lanesMask);
+            const auto hits = _mm_movemask_ps(inside);
+            if (!hits)
+                continue;
+
+            touched |= hits;
+
+            // move onto the surface, reflect and damp the velocity if approaching
+
+            const auto depth = _mm_and_ps(inside, d);
+            px = _mm_sub_ps(px, _mm_mul_ps(nx, depth));
+            py = _mm_sub_ps(py, _mm_mul_ps(ny, depth));
+            pz = _mm_sub_ps(pz, _mm_mul_ps(nz, depth));
+
+            const auto vn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, nx), _mm_mul_ps(vy, ny)), _mm_mul_ps(vz, nz));
+            const auto approaching = _mm_and_ps(inside, _mm_cmplt_ps(vn, sse_0));
+            const auto vn2 = _mm_mul_ps(sse_2, vn);
+
+            vx = _mm_blendv_ps(vx, _mm_mul_ps(_mm_sub_ps(vx, _mm_mul_ps(vn2, nx)), sse_damping), approaching);
+            vy = _mm_blendv_ps(vy, _mm_mul_ps(_mm_sub_ps(vy, _mm_mul_ps(vn2, ny)), sse_damping), approaching);
+            vz = _mm_blendv_ps(vz, _mm_mul_ps(_mm_sub_ps(vz, _mm_mul_ps(vn2, nz)), sse_damping), approaching);
+        }
+
+        if (!touched)
+            continue;
+
+        pw = _mm_blendv_ps(pw, _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)),
+            _mm_castsi128_ps(_mm_set_epi32(touched & 8 ? -1 : 0, touched & 4 ? -1 : 0, touched & 2 ? -1 : 0, touched & 1 ? -1 : 0)));
+
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+        _MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+
+        const __m128 p[4] = { px, py, pz, pw };
+        const __m128 v[4] = { vx, vy, vz, vw };
+        for (auto lane = 0; lane < lanes; ++lane)
+        {
+            _mm_store_ps(&positions[first + lane].x, p[lane]);
+            _mm_store_ps(&velocities[first + lane].x, v[lane]);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 4201)
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#pragma warning(pop)
+
+
+// For more information on how to write C++ please adhere to:
+// http://cginternals.github.io/guidelines/cpp/index.html
+
+// Static solids the particles bounce off, described by signed distance functions: spheres,
+// axis-aligned boxes, capsules, half-spaces below planes, and signed distance grids baked
+// into raw files. A particle inside a collider is moved back onto its surface and its
+// velocity is reflected and damped like at the ground plane. Up to 64 colliders are
+// supported; a uniform grid over the bounded ones stores a bit mask of the colliders
+// overlapping each cell, so every batch of four particles evaluates only the colliders of
+// its cells, in SIMD across the batch.
+class Colliders
+{
+public:
+    static const std::size_t maxColliders = 64;
+
+public:
+    Colliders();
+
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+
+    // Return false if the limit of colliders is reached.
+    bool addSphere(const glm::vec3 & center, float radius);
+    bool addBox(const glm::vec3 & center, const glm::vec3 & halfExtents);
+    bool addCapsule(const glm::vec3 & a, const glm::vec3 & b, float radius);
+    bool addPlane(const glm::vec3 & normal, float offset); // solid where dot(normal, p) < offset
+    // Grid of 32-bit float distances, x varying fastest, with its first sample at origin.
+    bool addField(const std::vector<float> & distances, const glm::ivec3 & resolution, const glm::vec3 & origin, float spacing);
+    bool addField(const std::string & rawFile, const glm::ivec3 & resolution, const glm::vec3 & origin, float spacing);
+
+    // Reads one collider per line, '#' starts a comment:
+    //   sphere <center x y z> <radius>
+    //   box <center x y z> <half extents x y z>
+    //   capsule <a x y z> <b x y z> <radius>
+    //   plane <normal x y z> <offset>
+    //   field <raw file> <resolution x y z> <origin x y z> <spacing>
+    bool load(const std::string & filePath);
+
+    // Resolves collisions of the first count particles; w of colliding positions is updated
+    // to the squared speed. Multi-threaded by OpenMP if parallel.
+    void collide(glm::vec4 * positions, glm::vec4 * velocities, std::int32_t count, bool parallel = true) const;
+
+protected:
+    enum class Shape
+    {
+        Sphere,
+        Box,
+        Capsule,
+        Plane,
+        Field
+    };
+
+    struct Collider
+    {
+        Shape shape;
+        glm::vec3 a;       // center, first capsule point, plane normal, or field origin
+        glm::vec3 b;       // half extents, second capsule point, or field resolution
+        float radius;      // of spheres and capsules, offset of planes, spacing of fields
+        std::size_t field; // index into m_fields
+    };
+
+    bool add(const Collider & collider);
+    void buildBroadphase();
+    std::uint64_t mask(const glm::vec4 & position) const;
+
+protected:
+    std::vector<Collider> m_colliders;
+    std::vector<std::vector<float>> m_fields;
+
+    std::uint64_t m_unbounded;          // mask of the planes, tested everywhere
+    glm::vec3 m_gridOrigin;
+    glm::vec3 m_gridScale;              // cells per unit
+    std::vector<std::uint64_t> m_cells; // collider mask per cell of the broadphase grid
+};
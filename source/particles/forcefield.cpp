@@ -0,0 +1,376 @@
+
+#include "forcefield.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <immintrin.h>
+
+#pragma warning(push)
+#pragma warning(disable : 4201)
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#pragma warning(pop)
+
+#include <cgutils/common.h>
+
+
+namespace
+{
+
+    const auto brickShift = 2;                     // bricks of 4^3 voxels
+    const auto brickMask = (1 << brickShift) - 1;
+    const auto brickVoxels = 1 << (3 * brickShift);
+
+    // Pseudo-random value in [-1, 1] per lattice point.
+    float lattice(const int x, const int y, const int z, const unsigned int seed)
+    {
+        auto h = (static_cast<std::uint32_t>(x) * 73856093u) ^ (static_cast<std::uint32_t>(y) * 19349663u)
+            ^ (static_cast<std::uint32_t>(z) * 83492791u) ^ (seed * 2654435761u);
+        h ^= h >> 13;
+        h *= 0x5BD1E995u;
+        h ^= h >> 15;
+
+        return static_cast<float>(h & 0xFFFFFFu) / 8388607.5f - 1.f;
+    }
+
+    // Value noise with quintic interpolation and its analytic gradient.
+    float noise(const glm::vec3 & p, const unsigned int seed, glm::vec3 & gradient)
+    {
+        const auto i = glm::floor(p);
+        const auto f = p - i;
+
+        const auto u = f * f * f * (f * (f * 6.f - 15.f) + 10.f);
+        const auto du = 30.f * f * f * (f * (f - 2.f) + 1.f);
+
+        const auto x = static_cast<int>(i.x);
+        const auto y = static_cast<int>(i.y);
+        const auto z = static_cast<int>(i.z);
+
+        const auto a = lattice(x, y, z, seed);
+        const auto b = lattice(x + 1, y, z, seed);
+        const auto c = lattice(x, y + 1, z, seed);
+        const auto d = lattice(x + 1, y + 1, z, seed);
+        const auto e = lattice(x, y, z + 1, seed);
+        const auto g = lattice(x + 1, y, z + 1, seed);
+        const auto h = lattice(x, y + 1, z + 1, seed);
+        const auto k = lattice(x + 1, y + 1, z + 1, seed);
+
+        const auto k1 = b - a;
+        const auto k2 = c - a;
+        const auto k3 = e - a;
+        const auto k4 = a - b - c + d;
+        const auto k5 = a - c - e + h;
+        const auto k6 = a - b - e + g;
+        const auto k7 = -a + b + c - d + e - g - h + k;
+
+        gradient = du * glm::vec3(
+            k1 + k4 * u.y + k6 * u.z + k7 * u.y * u.z,
+            k2 + k5 * u.z + k4 * u.x + k7 * u.z * u.x,
+            k3 + k6 * u.x + k5 * u.y + k7 * u.x * u.y);
+
+        return a + k1 * u.x + k2 * u.y + k3 * u.z + k4 * u.x * u.y + k5 * u.y * u.z + k6 * u.z * u.x + k7 * u.x * u.y * u.z;
+    }
+
+    __m128 lerp(const __m128 a, const __m128 b, const __m128 t)
+    {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+    }
+
+#ifdef BUILD_WITH_AVX2
+    __m256 lerp(const __m256 a, const __m256 b, const __m256 t)
+    {
+        return _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a);
+    }
+
+    // Trilinear interpolation of one component of the corners at the given float offsets.
+    __m256 trilinear(const float * vectors, const __m256i offsets[8], const __m256 tx, const __m256 ty, const __m256 tz)
+    {
+        const auto c000 = _mm256_i32gather_ps(vectors, offsets[0], 4);
+        const auto c100 = _mm256_i32gather_ps(vectors, offsets[1], 4);
+        const auto c010 = _mm256_i32gather_ps(vectors, offsets[2], 4);
+        const auto c110 = _mm256_i32gather_ps(vectors, offsets[3], 4);
+        const auto c001 = _mm256_i32gather_ps(vectors, offsets[4], 4);
+        const auto c101 = _mm256_i32gather_ps(vectors, offsets[5], 4);
+        const auto c011 = _mm256_i32gather_ps(vectors, offsets[6], 4);
+        const auto c111 = _mm256_i32gather_ps(vectors, offsets[7], 4);
+
+        return lerp(lerp(lerp(c000, c100, tx), lerp(c010, c110, tx), ty),
+            lerp(lerp(c001, c101, tx), lerp(c011, c111, tx), ty), tz);
+    }
+#endif
+
+}
+
+
+ForceField::ForceField()
+: m_resolution(0)
+, m_bricks(0)
+, m_origin(0.f)
+, m_scale(1.f)
+, m_strength(1.f)
+{
+}
+
+bool ForceField::empty() const
+{
+    return m_vectors.empty();
+}
+
+void ForceField::clear()
+{
+    m_vectors = std::vector<float, aligned_allocator<float, 32>>();
+    m_resolution = glm::ivec3(0);
+    m_bricks = glm::ivec3(0);
+}
+
+const glm::ivec3 & ForceField::resolution() const
+{
+    return m_resolution;
+}
+
+const glm::vec3 & ForceField::origin() const
+{
+    return m_origin;
+}
+
+float ForceField::spacing() const
+{
+    return 1.f / m_scale;
+}
+
+float ForceField::strength() const
+{
+    return m_strength;
+}
+
+void ForceField::setStrength(const float strength)
+{
+    m_strength = strength;
+}
+
+void ForceField::setup(const glm::ivec3 & resolution, const glm::vec3 & origin, const float spacing)
+{
+    m_resolution = glm::max(resolution, glm::ivec3(2));
+    m_bricks = (m_resolution + brickMask) / (1 << brickShift);
+    m_origin = origin;
+    m_scale = 1.f / spacing;
+
+    // the padding float allows loading the last vector as four floats
+    const auto voxels = static_cast<std::size_t>(m_bricks.x) * m_bricks.y * m_bricks.z * brickVoxels;
+    m_vectors.assign(voxels * 3 + 1, 0.f);
+}
+
+std::size_t ForceField::index(const int x, const int y, const int z) const
+{
+    const auto brick = (static_cast<std::size_t>(z >> brickShift) * m_bricks.y + (y >> brickShift)) * m_bricks.x + (x >> brickShift);
+    const auto voxel = ((z & brickMask) << (2 * brickShift)) + ((y & brickMask) << brickShift) + (x & brickMask);
+
+    return (brick * brickVoxels + voxel) * 3;
+}
+
+bool ForceField::load(const std::string & rawFile, const glm::ivec3 & resolution, const glm::vec3 & origin, const float spacing)
+{
+    const auto raw = cgutils::rawFromFile(rawFile.c_str());
+    const auto voxels = static_cast<std::size_t>(resolution.x) * resolution.y * resolution.z;
+
+    if (glm::any(glm::lessThan(resolution, glm::ivec3(2))) || spacing <= 0.f || raw.size() != voxels * 3 * sizeof(float))
+    {
+        std::cerr << "Force field " << rawFile << " does not hold " << resolution.x << "x" << resolution.y << "x"
+            << resolution.z << " vectors of 32-bit floats" << std::endl;
+        return false;
+    }
+
+    setup(resolution, origin, spacing);
+
+    const auto * vectors = reinterpret_cast<const float *>(raw.data());
+
+#pragma omp parallel for
+    for (auto z = 0; z < resolution.z; ++z)
+        for (auto y = 0; y < resolution.y; ++y)
+            for (auto x = 0; x < resolution.x; ++x)
+                std::copy_n(vectors + ((static_cast<std::size_t>(z) * resolution.y + y) * resolution.x + x) * 3, 3, &m_vectors[index(x, y, z)]);
+
+    return true;
+}
+
+void ForceField::generateCurlNoise(const glm::ivec3 & resolution, const glm::vec3 & origin, const float spacing, const float frequency, const unsigned int seed)
+{
+    setup(resolution, origin, spacing);
+
+    auto maxima = std::vector<float>(m_resolution.z, 0.f);
+
+#pragma omp parallel for
+    for (auto z = 0; z < m_resolution.z; ++z)
+    {
+        for (auto y = 0; y < m_resolution.y; ++y)
+            for (auto x = 0; x < m_resolution.x; ++x)
+            {
+                const auto p = (origin + glm::vec3(x, y, z) * spacing) * frequency;
+
+                // curl of the potential (n0, n1, n2) of independent noises
+                auto g0 = glm::vec3();
+                auto g1 = glm::vec3();
+                auto g2 = glm::vec3();
+                noise(p, seed, g0);
+                noise(p, seed + 1u, g1);
+                noise(p, seed + 2u, g2);
+
+                const auto curl = glm::vec3(g2.y - g1.z, g0.z - g2.x, g1.x - g0.y);
+                maxima[z] = std::max(maxima[z], glm::dot(curl, curl));
+
+                auto * v = &m_vectors[index(x, y, z)];
+                v[0] = curl.x;
+                v[1] = curl.y;
+                v[2] = curl.z;
+            }
+    }
+
+    const auto maximum = std::sqrt(*std::max_element(maxima.begin(), maxima.end()));
+    if (maximum <= 0.f)
+        return;
+
+    const auto normalization = 1.f / maximum;
+    for (auto & value : m_vectors)
+        value *= normalization;
+}
+
+glm::vec4 ForceField::sample(const glm::vec4 & position) const
+{
+    if (m_vectors.empty())
+        return glm::vec4(0.f);
+
+    const auto g = (glm::vec3(position) - m_origin) * m_scale;
+    const auto last = glm::vec3(m_resolution - 1);
+
+    // negated, so NaN counts as outside
+    if (!(g.x >= 0.f && g.y >= 0.f && g.z >= 0.f && g.x <= last.x && g.y <= last.y && g.z <= last.z))
+        return glm::vec4(0.f);
+
+    const auto i = glm::min(glm::ivec3(g), m_resolution - 2);
+    const auto f = g - glm::vec3(i);
+
+    const auto * v = m_vectors.data();
+    const auto c000 = _mm_loadu_ps(v + index(i.x, i.y, i.z));
+    const auto c100 = _mm_loadu_ps(v + index(i.x + 1, i.y, i.z));
+    const auto c010 = _mm_loadu_ps(v + index(i.x, i.y + 1, i.z));
+    const auto c110 = _mm_loadu_ps(v + index(i.x + 1, i.y + 1, i.z));
+    const auto c001 = _mm_loadu_ps(v + index(i.x, i.y, i.z + 1));
+    const auto c101 = _mm_loadu_ps(v + index(i.x + 1, i.y, i.z + 1));
+    const auto c011 = _mm_loadu_ps(v + index(i.x, i.y + 1, i.z + 1));
+    const auto c111 = _mm_loadu_ps(v + index(i.x + 1, i.y + 1, i.z + 1));
+
+    const auto tx = _mm_set1_ps(f.x);
+    const auto ty = _mm_set1_ps(f.y);
+    const auto tz = _mm_set1_ps(f.z);
+
+    auto a = lerp(lerp(lerp(c000, c100, tx), lerp(c010, c110, tx), ty),
+        lerp(lerp(c001, c101, tx), lerp(c011, c111, tx), ty), tz);
+    a = _mm_blend_ps(_mm_mul_ps(a, _mm_set1_ps(m_strength)), _mm_setzero_ps(), 0x8);
+
+    auto result = glm::vec4();
+    _mm_storeu_ps(&result.x, a);
+    return result;
+}
+
+#ifdef BUILD_WITH_AVX2
+void ForceField::sample8(const glm::vec4 * positions, glm::vec4 * accelerations) const
+{
+    if (m_vectors.empty())
+    {
+        std::fill_n(accelerations, 8, glm::vec4(0.f));
+        return;
+    }
+
+    const auto stride = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const auto scale = _mm256_set1_ps(m_scale);
+    const auto zero = _mm256_setzero_ps();
+
+    const auto gx = _mm256_mul_ps(_mm256_sub_ps(_mm256_i32gather_ps(&positions[0].x, stride, 4), _mm256_set1_ps(m_origin.x)), scale);
+    const auto gy = _mm256_mul_ps(_mm256_sub_ps(_mm256_i32gather_ps(&positions[0].y, stride, 4), _mm256_set1_ps(m_origin.y)), scale);
+    const auto gz = _mm256_mul_ps(_mm256_sub_ps(_mm256_i32gather_ps(&positions[0].z, stride, 4), _mm256_set1_ps(m_origin.z)), scale);
+
+    const auto last = glm::vec3(m_resolution - 1);
+    const auto inside = _mm256_and_ps(
+        _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(gx, zero, _CMP_GE_OQ), _mm256_cmp_ps(gx, _mm256_set1_ps(last.x), _CMP_LE_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(gy, zero, _CMP_GE_OQ), _mm256_cmp_ps(gy, _mm256_set1_ps(last.y), _CMP_LE_OQ))),
+        _mm256_and_ps(_mm256_cmp_ps(gz, zero, _CMP_GE_OQ), _mm256_cmp_ps(gz, _mm256_set1_ps(last.z), _CMP_LE_OQ)));
+
+    // lower corner clamped into the grid, max first as it returns its second operand for NaN
+
+    const auto fx = _mm256_min_ps(_mm256_max_ps(_mm256_floor_ps(gx), zero), _mm256_set1_ps(last.x - 1.f));
+    const auto fy = _mm256_min_ps(_mm256_max_ps(_mm256_floor_ps(gy), zero), _mm256_set1_ps(last.y - 1.f));
+    const auto fz = _mm256_min_ps(_mm256_max_ps(_mm256_floor_ps(gz), zero), _mm256_set1_ps(last.z - 1.f));
+
+    const auto tx = _mm256_sub_ps(gx, fx);
+    const auto ty = _mm256_sub_ps(gy, fy);
+    const auto tz = _mm256_sub_ps(gz, fz);
+
+    // the bricked offset is separable into a sum of per axis terms
+
+    const auto mask = _mm256_set1_epi32(brickMask);
+    const auto one = _mm256_set1_epi32(1);
+    const auto three = _mm256_set1_epi32(3);
+    const auto rowBricks = _mm256_set1_epi32(m_bricks.x * brickVoxels);
+    const auto sliceBricks = _mm256_set1_epi32(m_bricks.x * m_bricks.y * brickVoxels);
+
+    const auto offsetX = [&](const __m256i x)
+    {
+        return _mm256_mullo_epi32(_mm256_add_epi32(_mm256_slli_epi32(_mm256_srli_epi32(x, brickShift), 3 * brickShift),
+            _mm256_and_si256(x, mask)), three);
+    };
+    const auto offsetY = [&](const __m256i y)
+    {
+        return _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(y, brickShift), rowBricks),
+            _mm256_slli_epi32(_mm256_and_si256(y, mask), brickShift)), three);
+    };
+    const auto offsetZ = [&](const __m256i z)
+    {
+        return _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(z, brickShift), sliceBricks),
+            _mm256_slli_epi32(_mm256_and_si256(z, mask), 2 * brickShift)), three);
+    };
+
+    const auto ix = _mm256_cvttps_epi32(fx);
+    const auto iy = _mm256_cvttps_epi32(fy);
+    const auto iz = _mm256_cvttps_epi32(fz);
+
+    const auto x0 = offsetX(ix);
+    const auto x1 = offsetX(_mm256_add_epi32(ix, one));
+    const auto y0 = offsetY(iy);
+    const auto y1 = offsetY(_mm256_add_epi32(iy, one));
+    const auto z0 = offsetZ(iz);
+    const auto z1 = offsetZ(_mm256_add_epi32(iz, one));
+
+    const auto y0z0 = _mm256_add_epi32(y0, z0);
+    const auto y1z0 = _mm256_add_epi32(y1, z0);
+    const auto y0z1 = _mm256_add_epi32(y0, z1);
+    const auto y1z1 = _mm256_add_epi32(y1, z1);
+
+    const __m256i offsets[8] = {
+        _mm256_add_epi32(x0, y0z0), _mm256_add_epi32(x1, y0z0), _mm256_add_epi32(x0, y1z0), _mm256_add_epi32(x1, y1z0),
+        _mm256_add_epi32(x0, y0z1), _mm256_add_epi32(x1, y0z1), _mm256_add_epi32(x0, y1z1), _mm256_add_epi32(x1, y1z1) };
+
+    const auto strength = _mm256_and_ps(_mm256_set1_ps(m_strength), inside);
+    const auto * v = m_vectors.data();
+
+    alignas(32) float ax[8];
+    alignas(32) float ay[8];
+    alignas(32) float az[8];
+    _mm256_store_ps(ax, _mm256_mul_ps(trilinear(v, offsets, tx, ty, tz), strength));
+    _mm256_store_ps(ay, _mm256_mul_ps(trilinear(v + 1, offsets, tx, ty, tz), strength));
+    _mm256_store_ps(az, _mm256_mul_ps(trilinear(v + 2, offsets, tx, ty, tz), strength));
+
+    for (auto i = 0; i < 8; ++i)
+        accelerations[i] = glm::vec4(ax[i], ay[i], az[i], 0.f);
+}
+#endif
+
+void ForceField::slice(const int z, std::vector<float> & vectors) const
+{
+    vectors.resize(static_cast<std::size_t>(m_resolution.x) * m_resolution.y * 3);
+
+    for (auto y = 0; y < m_resolution.y; ++y)
+        for (auto x = 0; x < m_resolution.x; ++x)
+            std::copy_n(&m_vectors[index(x, y, z)], 3, &vectors[(static_cast<std::size_t>(y) * m_resolution.x + x) * 3]);
+}
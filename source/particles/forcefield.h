@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocator.h"
+
+#pragma warning(push)
+#pragma warning(disable : 4201)
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#pragma warning(pop)
+
+
+// For more information on how to write C++ please adhere to:
+// http://cginternals.github.io/guidelines/cpp/index.html
+
+// Spatially varying acceleration, e.g., wind or turbulence, given by a grid of vectors that
+// is interpolated trilinearly and zero outside. The grid is stored in bricks of 4^3 voxels
+// with interleaved components, so the eight corners of a sample lie within a few cache
+// lines of each other instead of rows and slices apart, and a brick spans few pages.
+class ForceField
+{
+public:
+    ForceField();
+
+    bool empty() const;
+    void clear();
+
+    const glm::ivec3 & resolution() const;
+    const glm::vec3 & origin() const; // position of the first voxel
+    float spacing() const;            // between voxels
+
+    // Factor of the grid vectors in m/s^2.
+    float strength() const;
+    void setStrength(float strength);
+
+    // Reads 32-bit float vectors (three components each) with x varying fastest.
+    bool load(const std::string & rawFile, const glm::ivec3 & resolution, const glm::vec3 & origin, float spacing);
+    // Divergence-free turbulence: the curl of a vector potential of value noise with the
+    // given features per unit length, normalized to a maximum length of 1.
+    void generateCurlNoise(const glm::ivec3 & resolution, const glm::vec3 & origin, float spacing, float frequency, unsigned int seed = 0);
+
+    // Acceleration at the position (w is zero), interpolating all components at once in SSE.
+    glm::vec4 sample(const glm::vec4 & position) const;
+#ifdef BUILD_WITH_AVX2
+    // Accelerations at eight positions, gathering the corners by AVX2.
+    void sample8(const glm::vec4 * positions, glm::vec4 * accelerations) const;
+#endif
+
+    // Vectors of the voxels with the given z in linear order, e.g., to upload a texture slice.
+    void slice(int z, std::vector<float> & vectors) const;
+
+protected:
+    void setup(const glm::ivec3 & resolution, const glm::vec3 & origin, float spacing);
+    std::size_t index(int x, int y, int z) const; // of the voxel's first component
+
+protected:
+    glm::ivec3 m_resolution;
+    glm::ivec3 m_bricks;
+    glm::vec3 m_origin;
+    float m_scale; // voxels per unit length
+    float m_strength;
+
+    std::vector<float, aligned_allocator<float, 32>> m_vectors; // bricked, one float of padding
+};
@@ -0,0 +1,103 @@
+#include "governor.h"
+
+#include <array>
+
+
+namespace
+{
+
+    const auto levels = std::array<Governor::Level, 5>{ {
+        { 1.00f, 8, 1 },
+        { 1.00f, 4, 1 },
+        { 0.75f, 2, 1 },
+        { 0.50f, 1, 2 },
+        { 0.25f, 1, 4 } } };
+
+    const auto smoothing = 0.1f; // weight of the latest frame in the moving average
+
+    const auto degradeThreshold = 1.0f; // fraction of the budget
+    const auto upgradeThreshold = 0.7f;
+    const auto degradeFrames = 8;
+    const auto upgradeFrames = 60;
+
+}
+
+
+Governor::Governor()
+: m_budget(0.f)
+, m_average(0.f)
+, m_level(0)
+, m_framesOver(0)
+, m_framesUnder(0)
+{
+}
+
+float Governor::budget() const
+{
+    return m_budget;
+}
+
+void Governor::setBudget(const float milliseconds)
+{
+    m_budget = milliseconds > 0.f ? milliseconds : 0.f;
+
+    m_average = 0.f;
+    m_framesOver = 0;
+    m_framesUnder = 0;
+
+    if (!enabled())
+        m_level = 0;
+}
+
+bool Governor::enabled() const
+{
+    return m_budget > 0.f;
+}
+
+bool Governor::update(const float frameMilliseconds)
+{
+    if (!enabled())
+        return false;
+
+    m_average = m_average > 0.f ? m_average + smoothing * (frameMilliseconds - m_average) : frameMilliseconds;
+
+    m_framesOver = m_average > m_budget * degradeThreshold ? m_framesOver + 1 : 0;
+    m_framesUnder = m_average < m_budget * upgradeThreshold ? m_framesUnder + 1 : 0;
+
+    const auto previous = m_level;
+
+    if (m_framesOver >= degradeFrames && m_level < numLevels() - 1)
+        ++m_level;
+    else if (m_framesUnder >= upgradeFrames && m_level > 0)
+        --m_level;
+
+    if (m_level == previous)
+        return false;
+
+    // let the average settle on the new level before the next decision
+    m_average = 0.f;
+    m_framesOver = 0;
+    m_framesUnder = 0;
+
+    return true;
+}
+
+int Governor::level() const
+{
+    return m_level;
+}
+
+int Governor::numLevels()
+{
+    return static_cast<int>(levels.size());
+}
+
+const Governor::Level & Governor::settings() const
+{
+    return levels[m_level];
+}
+
+float Governor::averageFrameTime() const
+{
+    return m_average;
+}
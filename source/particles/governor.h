@@ -0,0 +1,45 @@
+#pragma once
+
+
+// For more information on how to write C++ please adhere to:
+// http://cginternals.github.io/guidelines/cpp/index.html
+
+// Keeps frame times within a budget by trading simulation quality for cost. The frame
+// times are smoothed by an exponential moving average; the quality level is lowered after
+// several frames above the budget and raised after many frames well below it, which
+// avoids oscillating between two levels.
+class Governor
+{
+public:
+    struct Level
+    {
+        float activeFraction; // fraction of particles that are simulated and drawn
+        int maxSubsteps;      // processing steps per frame at most
+        int respawnStride;    // respawn pass every n-th processing step
+    };
+
+public:
+    Governor();
+
+    // Frame time budget in milliseconds, e.g., 16.6 or 8.3; 0 disables the governor.
+    float budget() const;
+    void setBudget(float milliseconds);
+    bool enabled() const;
+
+    // Accounts for the time of the last frame; returns true if the level changed.
+    bool update(float frameMilliseconds);
+
+    // Quality level from 0 (full quality) to numLevels() - 1.
+    int level() const;
+    static int numLevels();
+    const Level & settings() const;
+
+    float averageFrameTime() const;
+
+protected:
+    float m_budget;
+    float m_average;
+    int m_level;
+    int m_framesOver;
+    int m_framesUnder;
+};
@@ -0,0 +1,80 @@
+#include "integration.h"
+
+#include <array>
+#include <cmath>
+
+
+namespace
+{
+
+    const auto schemeNames = std::array<std::string, 4>{ "taylor", "verlet", "exponential", "rk4" };
+
+}
+
+
+Integration::Integration(const Scheme scheme, const float elapsed, const float friction)
+{
+    // in double precision, as the exponential push cancels for small steps
+    const auto h = static_cast<double>(elapsed);
+    const auto c = static_cast<double>(friction);
+    const auto x = c * h;
+
+    switch (scheme)
+    {
+    case Scheme::Taylor:
+    default:
+        drift = static_cast<float>(h * (1.0 - 0.5 * x));
+        push = static_cast<float>(0.5 * h * h);
+        decay = static_cast<float>(1.0 - x);
+        kick = static_cast<float>(h);
+        break;
+
+    case Scheme::VelocityVerlet:
+    {
+        // v' = v + h (a - c (v + v') / 2), then p' = p + h v'
+        const auto k = 1.0 / (1.0 + 0.5 * x);
+        decay = static_cast<float>((1.0 - 0.5 * x) * k);
+        kick = static_cast<float>(h * k);
+        drift = static_cast<float>(h * (1.0 - 0.5 * x) * k);
+        push = static_cast<float>(h * h * k);
+        break;
+    }
+
+    case Scheme::Exponential:
+    {
+        // v' = a / c + (v - a / c) e^(-ch), and p' its integral
+        const auto e = c > 0.0 ? -std::expm1(-x) / c : h; // (1 - e^(-ch)) / c
+        decay = static_cast<float>(std::exp(-x));
+        kick = static_cast<float>(e);
+        drift = static_cast<float>(e);
+        push = static_cast<float>(c > 0.0 ? (h - e) / c : 0.5 * h * h);
+        break;
+    }
+
+    case Scheme::RungeKutta4:
+        // the four stages collapse into the degree four expansion of the exact step
+        decay = static_cast<float>(1.0 - x + x * x / 2.0 - x * x * x / 6.0 + x * x * x * x / 24.0);
+        kick = static_cast<float>(h * (1.0 - x / 2.0 + x * x / 6.0 - x * x * x / 24.0));
+        drift = kick;
+        push = static_cast<float>(h * h * (0.5 - x / 6.0 + x * x / 24.0));
+        break;
+    }
+}
+
+std::string Integration::toString(const Scheme scheme)
+{
+    return schemeNames[static_cast<std::size_t>(scheme)];
+}
+
+bool Integration::fromString(const std::string & name, Scheme & scheme)
+{
+    for (auto i = 0ull; i < schemeNames.size(); ++i)
+    {
+        if (schemeNames[i] != name)
+            continue;
+
+        scheme = static_cast<Scheme>(i);
+        return true;
+    }
+    return false;
+}
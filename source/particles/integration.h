@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+
+
+// For more information on how to write C++ please adhere to:
+// http://cginternals.github.io/guidelines/cpp/index.html
+
+// A step of the particle motion dp/dt = v, dv/dt = a - friction * v, where a are the velocity
+// independent accelerations (gravity, force field, attraction), evaluated once at the start
+// of the step. With a held constant and linear friction, every scheme is a linear map
+//   p' = p + drift * v + push * a
+//   v' = decay * v + kick * a
+// thus all kernels share the coefficients of the step and cost the same for every scheme.
+//
+// Largest stable steps for friction c (0.3333) and a position dependent acceleration of
+// angular frequency w, e.g., the gradient of a force field or the attraction of a cluster:
+//   scheme          friction only   with w
+//   Taylor          2 / c (6 s)     about 2c / w^2
+//   VelocityVerlet  unconditional   2 / w
+//   Exponential     unconditional   about 2c / w^2
+//   RungeKutta4     2.785 / c       about 2c / w^2
+class Integration
+{
+public:
+    enum class Scheme
+    {
+        Taylor,         // p += v h + f h^2 / 2, v += f h with f = a - c v (first order in v)
+        VelocityVerlet, // kick then drift, trapezoidal friction; velocities are at half steps
+        Exponential,    // exact friction decay, i.e., exact for constant a at any step
+        RungeKutta4     // classic four stages, fourth order
+    };
+
+public:
+    Integration(Scheme scheme, float elapsed, float friction);
+
+    static std::string toString(Scheme scheme);
+    static bool fromString(const std::string & name, Scheme & scheme);
+
+public:
+    float drift;
+    float push;
+    float decay;
+    float kick;
+};
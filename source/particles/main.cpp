@@ -1,5 +1,10 @@
 
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 // C++ library for creating windows with OpenGL contexts and receiving 
 // input and events http://www.glfw.org/ 
@@ -8,9 +13,14 @@
 // C++ binding for the OpenGL API. 
 // https://github.com/cginternals/glbinding
 #include <glbinding/Binding.h>
+#include <glbinding/ContextInfo.h>
 
+#include <cgutils/arguments.h>
+#include <cgutils/benchmark.h>
 #include <cgutils/common.h>
+#include <cgutils/headless.h>
 
+#include "analysis.h"
 #include "particles.h"
 
 
@@ -21,10 +31,82 @@
 namespace
 {
 
-auto example = Particles();
+Particles example; // holds non-copyable performance counters
 
-const auto canvasWidth = 1440; // in pixel
-const auto canvasHeight = 900; // in pixel
+auto canvasWidth = 1440; // in pixel
+auto canvasHeight = 900; // in pixel
+
+const auto defaultHeadlessFrames = 1000;
+
+const auto defaultScalingParticles = "10000,100000,1000000,10000000";
+const auto defaultMinimumEfficiency = 0.5f;
+
+const auto defaultTuningCache = "particles-tuning.jsonl";
+
+const auto defaultDrawingParticles = "100000,1000000,10000000";
+const auto defaultDrawingFrames = 50;
+
+const auto defaultFrameBudget = 16.6f; // in milliseconds, used when toggling the governor by key
+
+const auto defaultFieldResolution = 64;
+const auto defaultFieldOrigin = glm::vec3(-2.f, 0.f, -2.f);
+const auto defaultFieldSpacing = 4.f / 63.f; // in m, the default field spans 4m in each direction
+const auto defaultFieldStrength = 4.f;       // in m/s^2
+const auto defaultFieldFrequency = 1.5f;     // curl noise features per m
+
+// options of the current run, e.g., for analyses triggered by key
+auto options = cgutils::Arguments(0, nullptr);
+
+// Parses a comma separated list of particle counts, e.g., "10000,100000".
+std::vector<int> particleCounts(const std::string & list)
+{
+    auto counts = std::vector<int>();
+    auto stream = std::stringstream(list);
+    auto count = std::string();
+    while (std::getline(stream, count, ','))
+    {
+        const auto value = std::atoi(count.c_str());
+        if (value > 0)
+            counts.push_back(value);
+    }
+    return counts;
+}
+
+// Parses a comma separated vector, e.g., "-2,0,-2"; a single value is used for all components.
+glm::vec3 vectorValue(const std::string & list, const glm::vec3 & defaultValue)
+{
+    auto values = std::vector<float>();
+    auto stream = std::stringstream(list);
+    auto value = std::string();
+    while (std::getline(stream, value, ','))
+        values.push_back(static_cast<float>(std::atof(value.c_str())));
+
+    if (values.size() == 1)
+        return glm::vec3(values[0]);
+    if (values.size() != 3)
+        return defaultValue;
+
+    return glm::vec3(values[0], values[1], values[2]);
+}
+
+// The compute shader processing does not evaluate the colliders.
+void warnIgnoredColliders()
+{
+    if (!example.colliders().empty() && example.processing() == Particles::ProcessingMode::GPU_ComputeShaders)
+        std::cerr << "Colliders are ignored by the compute shader processing" << std::endl;
+}
+
+void runScaling(const cgutils::Arguments & arguments)
+{
+    scalingReport(example, std::cout, particleCounts(arguments.value("scaling-particles", defaultScalingParticles)),
+        arguments.value("min-efficiency", defaultMinimumEfficiency));
+}
+
+void runDrawing(const cgutils::Arguments & arguments)
+{
+    drawingReport(example, std::cout, particleCounts(arguments.value("drawing-particles", defaultDrawingParticles)),
+        arguments.value("drawing-frames", defaultDrawingFrames));
+}
 
 // "The size callback ... which is called when the window is resized."
 // http://www.glfw.org/docs/latest/group__window.html#gaa40cd24840daa8c62f36cafc847c72b6
@@ -67,10 +149,37 @@ void keyCallback(GLFWwindow * /*window*/, int key, int /*scancode*/, int action,
         std::cout << "Benchmark started" << std::endl;
         break;
 
+    case GLFW_KEY_F7:
+        rooflineReport(example, std::cout);
+        break;
+
+    case GLFW_KEY_F8:
+        runScaling(options);
+        break;
+
+    case GLFW_KEY_F9:
+        runDrawing(options);
+        break;
+
     case GLFW_KEY_SPACE:
         example.pause();
         break;
 
+    case GLFW_KEY_G:
+        example.setFrameBudget(example.governor().enabled() ? 0.f : options.value("budget", defaultFrameBudget));
+        std::cout << "Governor: " << (example.governor().enabled() ? "on" : "off") << std::endl;
+        break;
+
+    case GLFW_KEY_C:
+        example.setGpuCulling(!example.gpuCulling());
+        std::cout << "GPU culling: " << (example.gpuCulling() ? "on" : "off") << std::endl;
+        break;
+
+    case GLFW_KEY_V:
+        example.setVertexPulling(!example.vertexPulling());
+        std::cout << "Quad expansion: " << (example.vertexPulling() ? "vertex pulling" : "geometry shader") << std::endl;
+        break;
+
     case GLFW_KEY_1:
         example.setProcessing(Particles::ProcessingMode::CPU);
         std::cout << "Processing: CPU" << std::endl;
@@ -90,10 +199,27 @@ void keyCallback(GLFWwindow * /*window*/, int key, int /*scancode*/, int action,
     case GLFW_KEY_5:
         example.setProcessing(Particles::ProcessingMode::GPU_ComputeShaders);
         std::cout << "Processing: GPU_ComputeShaders" << std::endl;
+        warnIgnoredColliders();
 #ifdef __APPLE__
         std::cout << "not supported by OS X" << std::endl;
 #endif
         break;
+    case GLFW_KEY_N:
+        example.setProcessing(Particles::ProcessingMode::CPU_OMP_BarnesHut);
+        std::cout << "Processing: CPU_OMP_BarnesHut" << std::endl;
+        break;
+    case GLFW_KEY_X:
+        if (example.setProcessing(Particles::ProcessingMode::CPU_OMP_AVX512))
+            std::cout << "Processing: CPU_OMP_AVX512" << std::endl;
+        else
+            std::cout << "Processing: CPU_OMP_AVX512 not available" << std::endl;
+        break;
+    case GLFW_KEY_K:
+        if (example.setProcessing(Particles::ProcessingMode::CPU_OMP_Compact))
+            std::cout << "Processing: CPU_OMP_Compact" << std::endl;
+        else
+            std::cout << "Processing: CPU_OMP_Compact not available" << std::endl;
+        break;
     case GLFW_KEY_6:
         example.setDrawing(Particles::DrawingMode::None);
         std::cout << "Drawing: None" << std::endl;
@@ -114,6 +240,14 @@ void keyCallback(GLFWwindow * /*window*/, int key, int /*scancode*/, int action,
         example.setDrawing(Particles::DrawingMode::Fluid);
         std::cout << "Drawing: Fluid" << std::endl;
         break;
+    case GLFW_KEY_MINUS:
+        example.setDrawing(Particles::DrawingMode::Splats);
+        std::cout << "Drawing: Splats" << std::endl;
+        break;
+    case GLFW_KEY_EQUAL:
+        example.setDrawing(Particles::DrawingMode::Translucent);
+        std::cout << "Drawing: Translucent" << std::endl;
+        break;
     }
 }
 
@@ -127,11 +261,232 @@ void errorCallback(int errnum, const char * errmsg)
 }
 
 
+// Applies the configuration given by command line or config file, e.g., 
+// "--processing avx2 --drawing fluid --particles 1000000 --scale 64". Unless the processing
+// mode is given or "--autotune false", the processing mode, threads, chunk size, and compute
+// shader configuration are taken from the tuning cache "--tuning-cache" or autotuned once per host ("--retune" to enforce).
+void configure(const cgutils::Arguments & arguments)
+{
+    if (arguments.value("autotune", true) && !arguments.has("processing"))
+        autotuneCached(example, arguments.value("tuning-cache", defaultTuningCache), arguments.value("retune", false), std::cout);
+
+    example.setThreads(arguments.value("threads", example.threads()));
+    example.setChunkSize(arguments.value("chunk-size", example.chunkSize()));
+    // [--group-size <invocations>] [--particles-per-thread <n>] compute shader processing
+    example.setComputeConfiguration(arguments.value("group-size", example.computeGroupSize()),
+        arguments.value("particles-per-thread", example.computeParticlesPerThread()));
+
+    // [--opening-angle <theta>] [--attraction <strength>] Barnes-Hut n-body processing
+    example.setOpeningAngle(arguments.value("opening-angle", example.openingAngle()));
+    example.setAttraction(arguments.value("attraction", example.attraction()));
+
+    // [--colliders <file>] spheres, boxes, capsules, planes, and distance fields, one per line
+    if (arguments.has("colliders"))
+        example.loadColliders(arguments.value("colliders", ""));
+
+    // [--force-field <raw file> | curl] grid of 32-bit float vectors or generated turbulence, with
+    // [--field-resolution <x,y,z>] [--field-origin <x,y,z>] [--field-spacing <m>] [--field-strength <m/s^2>]
+    // and, for the turbulence, [--field-frequency <features per m>]
+    if (arguments.has("force-field"))
+    {
+        const auto file = arguments.value("force-field", "");
+        const auto resolution = glm::ivec3(vectorValue(arguments.value("field-resolution", ""), glm::vec3(defaultFieldResolution)));
+        const auto origin = vectorValue(arguments.value("field-origin", ""), defaultFieldOrigin);
+        const auto spacing = arguments.value("field-spacing", defaultFieldSpacing);
+
+        if (file == "curl")
+            example.generateForceField(resolution, origin, spacing, arguments.value("field-frequency", defaultFieldFrequency));
+        else
+            example.loadForceField(file, resolution, origin, spacing);
+        example.setForceFieldStrength(arguments.value("field-strength", defaultFieldStrength));
+    }
+
+    // [--integrator <taylor|verlet|exponential|rk4>] [--max-step <s>] integration scheme and the
+    // longest step a frame is split into, e.g., exponential allows a single step per frame
+    auto integrator = example.integrator();
+    if (arguments.has("integrator") && !Integration::fromString(arguments.value("integrator", ""), integrator))
+        std::cerr << "Unknown integrator '" << arguments.value("integrator", "") << "'" << std::endl;
+    example.setIntegrator(integrator);
+    example.setMaxStep(arguments.value("max-step", example.maxStep()));
+
+    auto processing = example.processing();
+    if (arguments.has("processing") && !Particles::fromString(arguments.value("processing", ""), processing))
+        std::cerr << "Unknown processing mode '" << arguments.value("processing", "") << "'" << std::endl;
+    if (!example.setProcessing(processing))
+        std::cerr << "Processing mode '" << Particles::toString(processing) << "' is not available, using '"
+            << Particles::toString(example.processing()) << "'" << std::endl;
+    warnIgnoredColliders();
+
+    auto drawing = example.drawing();
+    if (arguments.has("drawing") && !Particles::fromString(arguments.value("drawing", ""), drawing))
+        std::cerr << "Unknown drawing mode '" << arguments.value("drawing", "") << "'" << std::endl;
+    example.setDrawing(drawing);
+
+    example.setScale(arguments.value("scale", example.scale()));
+
+    // [--emit-rate <particles/s>] [--lifetime <s>] GPU emitter of the compute shader processing
+    example.setEmitter(arguments.value("emit-rate", 0.f), arguments.value("lifetime", example.emitLifetime()));
+
+    // [--budget <ms>] adapt the simulation load to the frame budget, e.g., 16.6 or 8.3
+    example.setFrameBudget(arguments.value("budget", 0.f));
+
+    // [--fluid-scale <fraction>] fixed resolution of the fluid passes, or
+    // [--fluid-budget <ms>] GPU time for the fluid passes the resolution is adapted to
+    if (arguments.has("fluid-scale"))
+        example.setFluidScale(arguments.value("fluid-scale", 1.f));
+    example.setFluidBudget(arguments.value("fluid-budget", 0.f));
+    // [--fluid-radius <texels>] [--fluid-compute] depth smoothing radius and implementation
+    example.setFluidRadius(arguments.value("fluid-radius", example.fluidRadius()));
+    example.setFluidCompute(arguments.value("fluid-compute", false));
+
+    // [--vertex-pulling] expand quads in the vertex shader instead of the geometry shader
+    example.setVertexPulling(arguments.value("vertex-pulling", false));
+
+    // [--gpu-culling] [--cull-radius <pixels>] cull and compact particles on the GPU before drawing
+    example.setGpuCulling(arguments.value("gpu-culling", false));
+    example.setCullRadius(arguments.value("cull-radius", example.cullRadius()));
 }
 
+// Renders and measures "--frames" frames after "--warmup" frames and writes the 
+// configuration and frame times as JSON to "--output" (stdout by default) and 
+// appends it to the results store "--store" (see benchmark_compare).
+void runBenchmark(const cgutils::Arguments & arguments, const int frames, const std::function<void()> & swap)
+{
+    auto result = cgutils::BenchmarkResult();
+
+    result.set("example", "particles");
+    result.set("processing", Particles::toString(example.processing()));
+    result.set("drawing", Particles::toString(example.drawing()));
+    result.set("particles", example.numParticles());
+    result.set("omp_threads", example.threads());
+    result.set("chunk_size", example.chunkSize());
+    result.set("group_size", example.computeGroupSize());
+    result.set("particles_per_thread", example.computeParticlesPerThread());
+    result.set("opening_angle", example.openingAngle());
+    // colliders in effect, none for the compute shader processing
+    const auto gpu = example.processing() == Particles::ProcessingMode::GPU_ComputeShaders;
+    result.set("colliders", gpu ? 0 : static_cast<int>(example.colliders().size()));
+    result.set("integrator", Integration::toString(example.integrator()));
+    result.set("max_step", example.maxStep());
+    result.set("force_field", example.forceField().empty() ? std::string("none") : arguments.value("force-field", ""));
+    result.set("scale", example.scale());
+    result.set("width", canvasWidth);
+    result.set("height", canvasHeight);
+    result.set("headless", arguments.value("headless", false));
+    result.set("renderer", glbinding::ContextInfo::renderer());
+    result.setEnvironment();
+
+    const auto warmup = arguments.value("warmup", 0);
+    auto frame = 0;
+
+    cgutils::measureFrames(result, frames, warmup, [&swap, &frame, warmup]()
+    {
+        if (frame++ == warmup)
+            example.resetCounters();
 
-int main(int /*argc*/, char ** /*argv*/)
+        example.render();
+        swap();
+        gl::glFinish();
+    });
+
+    example.reportCounters(result);
+
+    result.set("emit_rate", example.emitRate());
+    result.set("lifetime", example.emitLifetime());
+    result.set("budget_ms", example.governor().budget());
+    result.setMetric("quality_level", example.governor().level());
+    result.setMetric("active_particles", example.numActiveParticles());
+    // the fluid scale is configured, or adapted to the budget during the run
+    const auto fluidBudget = arguments.value("fluid-budget", 0.f);
+    result.set("fluid_budget_ms", fluidBudget);
+    if (fluidBudget > 0.f)
+        result.setMetric("fluid_scale", example.fluidScale());
+    else
+        result.set("fluid_scale", example.fluidScale());
+    result.setMetric("fluid_ms", example.fluidTime());
+    result.set("fluid_radius", example.fluidRadius());
+    result.set("fluid_compute", example.fluidCompute());
+    result.set("vertex_pulling", example.vertexPullingActive());
+    result.setMetric("draw_ms", example.drawTime());
+    result.setMetric("sort_ms", example.sortTime());
+    result.set("gpu_culling", example.gpuCulling());
+    result.set("cull_radius", example.cullRadius());
+
+    result.write(arguments.value("output", "-"));
+
+    const auto store = arguments.value("store", "benchmarks.jsonl");
+    if (!store.empty())
+        result.append(store);
+}
+
+// [--roofline], [--verify], [--scaling], [--drawing-report] analyses that run once after initialization, see analysis.h
+bool analyses(const cgutils::Arguments & arguments)
 {
+    return arguments.value("roofline", false) || arguments.value("verify", false)
+        || arguments.value("scaling", false) || arguments.value("drawing-report", false);
+}
+
+void runAnalyses(const cgutils::Arguments & arguments)
+{
+    if (arguments.value("roofline", false))
+        rooflineReport(example, std::cout);
+    if (arguments.value("verify", false))
+        verificationReport(example, std::cout);
+    if (arguments.value("scaling", false))
+        runScaling(arguments);
+    if (arguments.value("drawing-report", false))
+        runDrawing(arguments);
+}
+
+// Renders a fixed number of frames into an offscreen pbuffer surface, i.e., 
+// without any window or display server.
+int runHeadless(const cgutils::Arguments & arguments)
+{
+    auto context = cgutils::HeadlessContext();
+    if (!context.create(canvasWidth, canvasHeight, 4, 1))
+        return 3;
+
+    glbinding::Binding::initialize(false);
+
+    example.resize(canvasWidth, canvasHeight);
+    example.initialize();
+
+    configure(arguments);
+
+    runAnalyses(arguments);
+
+    const auto frames = arguments.value("frames", analyses(arguments) ? 0 : defaultHeadlessFrames);
+    if (frames > 0)
+        runBenchmark(arguments, frames, [&context]() { context.swapBuffers(); });
+
+    example.cleanup();
+    context.destroy();
+
+    return 0;
+}
+
+}
+
+
+int main(int argc, char ** argv)
+{
+    // [--headless] render offscreen without any window, [--frames <n>] benchmark n frames and exit;
+    // see configure() for all other options, which can be given in a file by [--config <file>] as well
+    const auto arguments = cgutils::Arguments(argc, argv);
+    options = arguments;
+
+    canvasWidth = arguments.value("width", canvasWidth);
+    canvasHeight = arguments.value("height", canvasHeight);
+
+    example.setNumParticles(arguments.value("particles", example.numParticles()));
+
+    // [--counters] hardware performance counters, opened before any OpenMP worker thread exists
+    if (arguments.value("counters", false))
+        example.enableCounters();
+
+    if (arguments.value("headless", false))
+        return runHeadless(arguments);
+
     if (!glfwInit())
     {
         return 1;
@@ -161,19 +516,30 @@ int main(int /*argc*/, char ** /*argv*/)
     std::cout 
         << "  [F5] reload shaders" << std::endl
         << "  [F6] benchmark" << std::endl
+        << "  [F7] roofline report of all processing modes (csv)" << std::endl
+        << "  [F8] thread scaling report of all OpenMP processing modes (csv)" << std::endl
+        << "  [F9] geometry shader vs. vertex pulling report of the quad drawing modes (csv)" << std::endl
         << "  [Space] pause processing (toggle)" << std::endl
+        << "  [g] frame budget governor (toggle)" << std::endl
+        << "  [v] quad expansion by vertex pulling (toggle)" << std::endl
+        << "  [c] GPU culling and indirect drawing (toggle)" << std::endl
         << std::endl
         << "  [1] particle processing: CPU default" << std::endl
         << "  [2] particle processing: CPU_OMP" << std::endl
         << "  [3] particle processing: CPU_OMP_SSE41" << std::endl
         << "  [4] particle processing: CPU_OMP_AVX2" << std::endl
         << "  [5] particle processing: GPU_ComputeShaders" << std::endl
+        << "  [n] particle processing: CPU_OMP_BarnesHut, mutual attraction" << std::endl
+        << "  [x] particle processing: CPU_OMP_AVX512" << std::endl
+        << "  [k] particle processing: CPU_OMP_Compact" << std::endl
         << std::endl
         << "  [6] particle drawing: none/skip" << std::endl
         << "  [7] particle drawing: built-in points" << std::endl
         << "  [8] particle drawing: custom quads" << std::endl
         << "  [9] particle drawing: custom, shaded quads" << std::endl
         << "  [0] particle drawing: fluid" << std::endl
+        << "  [-] particle drawing: compute shader splats" << std::endl
+        << "  [=] particle drawing: translucent, sorted by depth" << std::endl
         << std::endl
         << "  [a/d] rotate left/right" << std::endl
         << "  [S/s] increase/decrease particle scale" << std::endl
@@ -188,6 +554,20 @@ int main(int /*argc*/, char ** /*argv*/)
     example.resize(width, height);
     example.initialize();
 
+    configure(arguments);
+
+    runAnalyses(arguments);
+    if (arguments.has("frames"))
+    {
+        runBenchmark(arguments, arguments.value("frames", 0), [window]()
+        {
+            glfwPollEvents();
+            glfwSwapBuffers(window);
+        });
+    }
+    if (analyses(arguments) || arguments.has("frames"))
+        glfwSetWindowShouldClose(window, true);
+
     while (!glfwWindowShouldClose(window)) // main loop
     {
         glfwPollEvents();
@@ -1,16 +1,24 @@
 
 #include "particles.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <string>
 #include <random>
 #include <chrono>
 
 #include <immintrin.h>
 
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
 #pragma warning(push)
 #pragma warning(disable : 4201)
+#include <glm/vec2.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/random.hpp>
@@ -19,8 +27,11 @@
 #include <glbinding/gl32ext/gl.h>
 #include <glbinding/ContextInfo.h>
 
+#include <cgutils/benchmark.h>
 #include <cgutils/common.h>
 
+#include "batch.h"
+
 
 using namespace gl32core;
 
@@ -28,9 +39,47 @@ using namespace gl32core;
 namespace
 {
 
+    // of all processing modes, the compute shaders receive them as uniforms
     const auto gravity = glm::vec4(0.0f, -9.80665f, 0.0f, 0.0f); // m/s^2;
     const auto friction = 0.3333f;
-    const auto velocityThreshold = 0.01f;
+    const auto velocityThreshold = 0.01f; // squared speed below which particles respawn
+    const auto defaultMaxStep = 0.016f; // in s, of a processing step
+
+    // widest SIMD mode built; initialization is faulty when beginning with GPU
+#ifdef BUILD_WITH_AVX2
+    const auto defaultProcessing = Particles::ProcessingMode::CPU_OMP_AVX2;
+#else
+    const auto defaultProcessing = Particles::ProcessingMode::CPU_OMP_SSE41;
+#endif
+
+    const auto minimumFluidScale = 0.25f;
+    const auto fluidScaleStep = 1.f / 16.f;  // quantization, avoids reallocating on every small change
+    const auto fluidDegradeThreshold = 1.1f; // fraction of the fluid budget
+    const auto fluidUpgradeThreshold = 0.7f;
+    const auto fluidSettleFrames = 8;        // frames after a change until measurements reflect it
+    const auto maximumFluidRadius = 32;      // MAX_RADIUS in fluid-smooth.comp
+    const auto fluidGroupSize = 128;         // GROUP_SIZE in fluid-smooth.comp
+
+    const auto splatGroupSize = 256;         // local_size_x in particles-splat.comp
+    const auto cullGroupSize = 256;          // local_size_x in particles-cull.comp
+    const auto sortGroupSize = 256;          // GROUP_SIZE in particles-sort.comp
+    const auto sortTileSize = 256 * 16;      // GROUP_SIZE * ITEMS in particles-sort.comp
+    const auto sortRadix = 256;
+    const auto sortPasses = 3;               // of 8-bit digits of the 24-bit depth keys
+    const auto defaultGroupSize = 64;        // local_size_x of the update kernel, see particles.comp
+    const auto maximumGroupSize = 1024;      // minimum of GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS guaranteed
+
+    const auto parkedPosition = glm::vec4(0.f, -1000.f, 0.f, 0.f); // of dead particles, see particles.comp
+    const auto maximumGroupCount = 65535;    // minimum of GL_MAX_COMPUTE_WORK_GROUP_COUNT guaranteed
+
+    const auto blockSize = 16;               // particles per iteration of the CPU kernels, sampled at once
+
+    const auto processingModeNames = std::array<std::string, 8>{
+        "cpu", "omp", "sse41", "avx2", "gpu", "nbody", "avx512", "compact" };
+    const auto drawingModeNames = std::array<std::string, 7>{
+        "none", "points", "quads", "shaded", "fluid", "splats", "translucent" };
+
+    const auto depthRange = glm::vec2(0.1f, 8.f); // near and far plane of the projection
 
 #ifdef SYSTEM_DARWIN
 #define thread_local 
@@ -49,6 +98,22 @@ namespace
     }
 
 
+    // Reads a timer query in milliseconds if its result is available, i.e., without stalling.
+    bool readTimerQuery(const GLuint query, float & milliseconds)
+    {
+        auto available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+
+        auto nanoseconds = gl::GLuint64(0);
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        milliseconds = static_cast<float>(nanoseconds) * 1e-6f;
+
+        return true;
+    }
+
+
     glm::ivec3 getMaxComputeWorkGroupCounts()
     {
         auto counts = glm::ivec3{};
@@ -60,22 +125,238 @@ namespace
     }
 
 
+    using ScalarBatch = simd::batch<float, 4>;
+#if defined(BUILD_WITH_AVX512)
+    using WidestBatch = simd::batch<float, 16, simd::AVX512>;
+#elif defined(BUILD_WITH_AVX2)
+    using WidestBatch = simd::batch<float, 8, simd::AVX2>;
+#else
+    using WidestBatch = simd::batch<float, 4, simd::SSE41>;
+#endif
+
+    // The processing step of all CPU modes on Batch::size / 4 particles at once: integration,
+    // the bounce off the ground, and the squared speed in the position's w.
+    template <typename Batch>
+    class Kernel
+    {
+    public:
+        explicit Kernel(const Integration & step)
+        : m_drift(step.drift)
+        , m_push(step.push)
+        , m_decay(step.decay)
+        , m_kick(step.kick)
+        , m_gravity(Batch::repeat(gravity.x, gravity.y, gravity.z, gravity.w))
+        , m_zero(0.f)
+        , m_one(1.f)
+        , m_flip(Batch::repeat(1.f, -1.f, 1.f, 1.f))
+        , m_bounce(Batch::repeat(1.f, -1.f, 1.f, 1.f) * Batch(1.f - friction))
+        , m_w(m_zero < Batch::repeat(0.f, 0.f, 0.f, 1.f))
+        {
+        }
+
+        // Accelerations in addition to gravity are optional.
+        void operator()(float * position, float * velocity, const float * acceleration) const
+        {
+            auto p = Batch::load(position);
+            auto v = Batch::load(velocity);
+
+            const auto a = acceleration ? m_gravity + Batch::load(acceleration) : m_gravity;
+
+            p = fma(v, m_drift, fma(a, m_push, p));
+            v = fma(v, m_decay, a * m_kick);
+
+            const auto below = p.template splat<1>() < m_zero;
+            p = p * select(below, m_flip, m_one);
+            v = v * select(below, m_bounce, m_one);
+
+            p = select(m_w, dot3(v, v), p);
+
+            p.store(position);
+            v.store(velocity);
+        }
+
+    protected:
+        Batch m_drift;
+        Batch m_push;
+        Batch m_decay;
+        Batch m_kick;
+        Batch m_gravity;
+        Batch m_zero;
+        Batch m_one;
+        Batch m_flip;   // of the y component
+        Batch m_bounce; // flip and friction
+        typename Batch::mask m_w;
+    };
+
+
+#ifdef BUILD_WITH_AVX2
+
+    // Four particles of three floats each, i.e., xyzx yzxy zxyz, into four vec4 with w zero.
+    void expand(const __m128 a, const __m128 b, const __m128 c, glm::vec4 * v)
+    {
+        const auto xyz = 0x7; // blend mask of the first three lanes
+        const auto zero = _mm_setzero_ps();
+
+        const auto ab = _mm_castsi128_ps(_mm_alignr_epi8(_mm_castps_si128(b), _mm_castps_si128(a), 12));
+        const auto bc = _mm_castsi128_ps(_mm_alignr_epi8(_mm_castps_si128(c), _mm_castps_si128(b), 8));
+        const auto cc = _mm_castsi128_ps(_mm_alignr_epi8(_mm_castps_si128(c), _mm_castps_si128(c), 4));
+
+        _mm_store_ps(glm::value_ptr(v[0]), _mm_blend_ps(zero, a, xyz));
+        _mm_store_ps(glm::value_ptr(v[1]), _mm_blend_ps(zero, ab, xyz));
+        _mm_store_ps(glm::value_ptr(v[2]), _mm_blend_ps(zero, bc, xyz));
+        _mm_store_ps(glm::value_ptr(v[3]), _mm_blend_ps(zero, cc, xyz));
+    }
+
+    // And vice versa, dropping w.
+    void compress(const glm::vec4 * v, __m128 & a, __m128 & b, __m128 & c)
+    {
+        const auto v0 = _mm_load_ps(glm::value_ptr(v[0]));
+        const auto v1 = _mm_load_ps(glm::value_ptr(v[1]));
+        const auto v2 = _mm_load_ps(glm::value_ptr(v[2]));
+        const auto v3 = _mm_load_ps(glm::value_ptr(v[3]));
+
+        a = _mm_blend_ps(v0, _mm_shuffle_ps(v1, v1, _MM_SHUFFLE(0, 0, 0, 0)), 0x8);
+        b = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 0, 2, 1));
+        c = _mm_blend_ps(_mm_shuffle_ps(v3, v3, _MM_SHUFFLE(2, 1, 0, 0)), _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(2, 2, 2, 2)), 0x1);
+    }
+
+    // Converts a full block of the compact storage into vec4, the half float velocities by F16C.
+    void unpackBlock(const glm::vec3 * positions, const std::uint16_t * velocities, glm::vec4 * p, glm::vec4 * v)
+    {
+        const auto floats = glm::value_ptr(positions[0]);
+
+        for (auto i = 0; i < blockSize / 8; ++i)
+        {
+            const auto h0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(velocities + 24 * i)));
+            const auto h1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(velocities + 24 * i + 8)));
+            const auto h2 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(velocities + 24 * i + 16)));
+
+            expand(_mm256_castps256_ps128(h0), _mm256_extractf128_ps(h0, 1), _mm256_castps256_ps128(h1), v + 8 * i);
+            expand(_mm256_extractf128_ps(h1, 1), _mm256_castps256_ps128(h2), _mm256_extractf128_ps(h2, 1), v + 8 * i + 4);
+        }
+
+        for (auto i = 0; i < blockSize / 4; ++i)
+            expand(_mm_loadu_ps(floats + 12 * i), _mm_loadu_ps(floats + 12 * i + 4), _mm_loadu_ps(floats + 12 * i + 8), p + 4 * i);
+    }
+
+    // Converts a full block back, rounding the velocities to the nearest half float.
+    void packBlock(const glm::vec4 * p, const glm::vec4 * v, glm::vec3 * positions, std::uint16_t * velocities)
+    {
+        const auto floats = glm::value_ptr(positions[0]);
+
+        for (auto i = 0; i < blockSize / 8; ++i)
+        {
+            __m128 a, b, c, d, e, f;
+            compress(v + 8 * i, a, b, c);
+            compress(v + 8 * i + 4, d, e, f);
+
+            const auto h0 = _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+            const auto h1 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), d, 1);
+            const auto h2 = _mm256_insertf128_ps(_mm256_castps128_ps256(e), f, 1);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(velocities + 24 * i), _mm256_cvtps_ph(h0, _MM_FROUND_TO_NEAREST_INT));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(velocities + 24 * i + 8), _mm256_cvtps_ph(h1, _MM_FROUND_TO_NEAREST_INT));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(velocities + 24 * i + 16), _mm256_cvtps_ph(h2, _MM_FROUND_TO_NEAREST_INT));
+        }
+
+        for (auto i = 0; i < blockSize / 4; ++i)
+        {
+            __m128 a, b, c;
+            compress(p + 4 * i, a, b, c);
+
+            _mm_storeu_ps(floats + 12 * i, a);
+            _mm_storeu_ps(floats + 12 * i + 4, b);
+            _mm_storeu_ps(floats + 12 * i + 8, c);
+        }
+    }
+
+    // Converts count (up to a block) particles, copying a partial block; its remainder is zero.
+    void unpackBlock(const glm::vec3 * positions, const std::uint16_t * velocities, const int count, glm::vec4 * p, glm::vec4 * v)
+    {
+        if (count == blockSize)
+            return unpackBlock(positions, velocities, p, v);
+
+        glm::vec3 partialPositions[blockSize] = {};
+        std::uint16_t partialVelocities[3 * blockSize] = {};
+        std::copy(positions, positions + count, partialPositions);
+        std::copy(velocities, velocities + 3 * count, partialVelocities);
+
+        unpackBlock(partialPositions, partialVelocities, p, v);
+    }
+
+    void packBlock(const glm::vec4 * p, const glm::vec4 * v, const int count, glm::vec3 * positions, std::uint16_t * velocities)
+    {
+        if (count == blockSize)
+            return packBlock(p, v, positions, velocities);
+
+        glm::vec3 partialPositions[blockSize];
+        std::uint16_t partialVelocities[3 * blockSize];
+        packBlock(p, v, partialPositions, partialVelocities);
+
+        std::copy(partialPositions, partialPositions + count, positions);
+        std::copy(partialVelocities, partialVelocities + 3 * count, velocities);
+    }
+
+#endif
+
 }
 
 
 Particles::Particles()
-: m_processingMode(ProcessingMode::CPU_OMP_AVX2) // initialization is faulty when beginning with GPU
+: m_positionTexture(0)
+, m_maxBufferTexels(0)
+, m_vertexPulling(false)
+, m_splatBuffer(0)
+, m_gpuCulling(false)
+, m_cullRadius(0.f)
+, m_visibleBuffer(0)
+, m_commandBuffer(0)
+, m_visibleCapacity(0)
+, m_emitRate(0.f)
+, m_emitLifetime(4.f)
+, m_emitBudget(0.f)
+, m_emitterBuffer(0)
+, m_deadBuffer(0)
+, m_sortHistogram(0)
+, m_orderTexture(0)
+, m_sortCapacity(0)
+, m_fieldTexture(0)
+, m_drawFrame(0)
+, m_drawTime(0.f)
+, m_sortTime(0.f)
+, m_fluidScale(1.f)
+, m_fluidBudget(0.f)
+, m_fluidFramesSinceChange(0)
+, m_fluidWidth(1)
+, m_fluidHeight(1)
+, m_fluidRadius(8)
+, m_fluidCompute(false)
+, m_groupSize(defaultGroupSize)
+, m_particlesPerThread(1)
+, m_maxGroupSize(maximumGroupSize)
+, m_maxGroupCount(maximumGroupCount)
+, m_processingMode(defaultProcessing)
 , m_drawMode(DrawingMode::Fluid)
 , m_num(100000)
+, m_active(100000)
+, m_integrator(Integration::Scheme::Taylor)
+, m_maxStep(defaultMaxStep)
+, m_steps(0)
 , m_radius(128.f)
+, m_measure(false)
+, m_measureCount(0)
+, m_threads(0)
+, m_chunkSize(0)
+, m_countedParticles(0)
+, m_countedTime(0)
 , m_paused(false)
 , m_time(std::chrono::high_resolution_clock::now())
 , m_time0(std::chrono::high_resolution_clock::now())
 , m_bufferStorageAvailable(false)
 , m_bufferPointer(nullptr)
 , m_computeShadersAvailable(false)
-, m_measure(false)
-, m_measureCount(0)
+, m_int64AtomicsAvailable(false)
+, m_initialized(false)
 {
 }
 
@@ -106,6 +387,19 @@ Particles::~Particles()
     }
 
     //glDeleteTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+    glDeleteTextures(1, &m_positionTexture);
+    glDeleteTextures(1, &m_fieldTexture);
+    glDeleteBuffers(1, &m_splatBuffer);
+    glDeleteBuffers(1, &m_visibleBuffer);
+    glDeleteBuffers(1, &m_commandBuffer);
+    glDeleteBuffers(1, &m_emitterBuffer);
+    glDeleteBuffers(1, &m_deadBuffer);
+    glDeleteBuffers(static_cast<GLsizei>(m_sortKeys.size()), m_sortKeys.data());
+    glDeleteBuffers(static_cast<GLsizei>(m_sortValues.size()), m_sortValues.data());
+    glDeleteBuffers(1, &m_sortHistogram);
+    glDeleteTextures(1, &m_orderTexture);
+    glDeleteQueries(static_cast<GLsizei>(m_drawQueries.size()), m_drawQueries.data());
+    glDeleteQueries(static_cast<GLsizei>(m_sortQueries.size()), m_sortQueries.data());
 }
 
 void Particles::setupBuffer(const bool mapBuffer, const bool bufferStorageAvailable)
@@ -155,10 +449,26 @@ void Particles::setupBuffer(const bool mapBuffer, const bool bufferStorageAvaila
 
 void Particles::initialize()
 {
+    // schedule(runtime) would otherwise default to the runtime's choice, e.g., dynamic with chunk size 1
+    setChunkSize(m_chunkSize);
+
     // can map and unmap buffer api be used
     //m_bufferStorageAvailable = glbinding::ContextInfo::supported({ GLextension::GL_ARB_buffer_storage });
     // can compute shader 
     m_computeShadersAvailable = glbinding::ContextInfo::supported({ GLextension::GL_ARB_compute_shader });
+    // can splat with 64-bit atomics, i.e., keep color along with depth
+    m_int64AtomicsAvailable = m_computeShadersAvailable && glbinding::ContextInfo::supported(
+        { GLextension::GL_ARB_gpu_shader_int64, GLextension::GL_NV_shader_atomic_int64 });
+
+    if (m_computeShadersAvailable)
+    {
+        auto maxGroupSize = 0;
+        glGetIntegeri_v(gl::GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxGroupSize);
+
+        m_maxGroupSize = std::max(1, std::min(getComputeMaxInvocations(), maxGroupSize));
+        m_maxGroupCount = std::max(1, getMaxComputeWorkGroupCounts().x);
+        m_groupSize = std::min(m_groupSize, m_maxGroupSize);
+    }
 
     // setup common state
 
@@ -177,6 +487,17 @@ void Particles::initialize()
     glGenTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
     //glGenRenderbuffers(static_cast<GLsizei>(m_renderBuffers.size()), m_renderBuffers.data());
     glGenFramebuffers(static_cast<GLsizei>(m_fbo.size()), m_fbo.data());
+
+    glGenTextures(1, &m_positionTexture);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &m_maxBufferTexels);
+
+    glGenQueries(static_cast<GLsizei>(m_drawQueries.size()), m_drawQueries.data());
+    m_drawQueryIssued.fill(false);
+    glGenQueries(static_cast<GLsizei>(m_sortQueries.size()), m_sortQueries.data());
+    m_sortQueryIssued.fill(false);
+
+    m_fluidWidth = std::max(1, static_cast<int>(m_width * m_fluidScale + 0.5f));
+    m_fluidHeight = std::max(1, static_cast<int>(m_height * m_fluidScale + 0.5f));
     
     static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0 };
 
@@ -184,7 +505,7 @@ void Particles::initialize()
    
     glBindTexture(GL_TEXTURE_2D, m_textures[0]);
     //glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_width, m_height, 0, GL_RED, GL_FLOAT, nullptr);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_fluidWidth, m_fluidHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(GL_NEAREST));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(GL_NEAREST));
@@ -204,28 +525,64 @@ void Particles::initialize()
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 
-    // setup render target for fluid pass (temp for sparated blur)
+    // setup render targets for the separable smoothing (horizontal, then vertical; the
+    // latter is upsampled in the composite pass)
 
-    glBindTexture(GL_TEXTURE_2D, m_textures[1]);
-    //glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_width, m_height, 0, GL_RED, GL_FLOAT, nullptr);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    for (auto i = 1; i < 3; ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_fluidWidth, m_fluidHeight, 0, GL_RED, GL_FLOAT, nullptr);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(GL_NEAREST));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(GL_NEAREST));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(GL_CLAMP_TO_EDGE));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(GL_CLAMP_TO_EDGE));
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo[i]);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textures[i], 0);
+        glDrawBuffers(1, drawBuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(GL_NEAREST));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(GL_NEAREST));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(GL_CLAMP_TO_EDGE));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(GL_CLAMP_TO_EDGE));
-    //glBindTexture(GL_TEXTURE_2D, 0);
 
-    //glBindRenderbuffer(GL_RENDERBUFFER, m_renderBuffers[1]);
-    //glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
-    ////glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    // setup splat buffer, cleared to the maximum depth each frame
 
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo[1]);
-    //glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textures[1], 0);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_textures[1], 0);
-    //glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_renderBuffers[1]);
-    glDrawBuffers(1, drawBuffers);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGenBuffers(1, &m_splatBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_splatBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (m_int64AtomicsAvailable ? 8 : 4) * m_width * m_height, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+
+    // setup compacted buffer and indirect draw command of the cull pass; the former grows on demand
+
+    glGenBuffers(1, &m_visibleBuffer);
+    glGenBuffers(1, &m_commandBuffer);
+
+    glGenBuffers(1, &m_emitterBuffer);
+    glGenBuffers(1, &m_deadBuffer);
+
+    // setup buffers of the depth sort, allocated on demand
+
+    glGenBuffers(static_cast<GLsizei>(m_sortKeys.size()), m_sortKeys.data());
+    glGenBuffers(static_cast<GLsizei>(m_sortValues.size()), m_sortValues.data());
+    glGenBuffers(1, &m_sortHistogram);
+    glGenTextures(1, &m_orderTexture);
+
+    // setup force field texture, uploaded with the field
+
+    glGenTextures(1, &m_fieldTexture);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_commandBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(std::uint32_t) * 4, nullptr, GL_DYNAMIC_DRAW);
+
+    glBindVertexArray(m_vaos[3]);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, m_visibleBuffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), nullptr);
+    glBindVertexArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 
     // setup screen aligned triangle 
@@ -245,7 +602,12 @@ void Particles::initialize()
     setupShaders();
     setupTextures();
 
+    if (m_computeShadersAvailable && !m_forceField.empty())
+        uploadForceField();
+
     prepare();
+
+    m_initialized = true;
 }
 
 void Particles::cleanup()
@@ -303,6 +665,23 @@ void Particles::setupShaders()
     if (m_computeShadersAvailable)
     {
         glAttachShader(m_programs[3], m_computeShaders[0]);
+        glAttachShader(m_programs[7], m_computeShaders[1]);
+
+        glAttachShader(m_programs[11], m_computeShaders[2]);
+
+        glAttachShader(m_programs[13], m_computeShaders[3]);
+
+        glAttachShader(m_programs[14], m_computeShaders[4]);
+        glAttachShader(m_programs[15], m_computeShaders[5]);
+        glAttachShader(m_programs[16], m_computeShaders[6]);
+
+        glAttachShader(m_programs[17], m_computeShaders[7]);
+        glAttachShader(m_programs[18], m_computeShaders[8]);
+        glAttachShader(m_programs[19], m_computeShaders[9]);
+        glAttachShader(m_programs[20], m_computeShaders[10]);
+
+        glAttachShader(m_programs[12], m_vertexShaders[2]);
+        glAttachShader(m_programs[12], m_fragmentShaders[6]);
     }
 
     glAttachShader(m_programs[4], m_vertexShaders[1]);
@@ -312,18 +691,43 @@ void Particles::setupShaders()
     glAttachShader(m_programs[5], m_vertexShaders[2]);
     glAttachShader(m_programs[5], m_fragmentShaders[4]);
 
+    glAttachShader(m_programs[6], m_vertexShaders[2]);
+    glAttachShader(m_programs[6], m_fragmentShaders[5]);
+
+    // vertex pulling variants of programs 1, 2, and 4
+
+    glAttachShader(m_programs[8], m_vertexShaders[3]);
+    glAttachShader(m_programs[8], m_fragmentShaders[1]);
+
+    glAttachShader(m_programs[9], m_vertexShaders[3]);
+    glAttachShader(m_programs[9], m_fragmentShaders[2]);
+
+    glAttachShader(m_programs[10], m_vertexShaders[4]);
+    glAttachShader(m_programs[10], m_fragmentShaders[3]);
+
+    // translucent quads, pulled in sorted order
+
+    glAttachShader(m_programs[21], m_vertexShaders[5]);
+    glAttachShader(m_programs[21], m_fragmentShaders[7]);
+
     glBindFragDataLocation(m_programs[0], 0, "out_color");
     glBindFragDataLocation(m_programs[1], 0, "out_color");
     glBindFragDataLocation(m_programs[2], 0, "out_color");
     glBindFragDataLocation(m_programs[4], 0, "out_color");
-    glBindFragDataLocation(m_programs[5], 0, "out_color");
+    glBindFragDataLocation(m_programs[5], 0, "out_depth");
+    glBindFragDataLocation(m_programs[6], 0, "out_color");
+    glBindFragDataLocation(m_programs[8], 0, "out_color");
+    glBindFragDataLocation(m_programs[9], 0, "out_color");
+    glBindFragDataLocation(m_programs[10], 0, "out_color");
+    glBindFragDataLocation(m_programs[12], 0, "out_color");
+    glBindFragDataLocation(m_programs[21], 0, "out_color");
 
     loadShaders();
 }
 
-bool Particles::loadShader(GLuint & shader, const std::string & sourceFile) const
+bool Particles::loadShader(GLuint & shader, const std::string & sourceFile, const std::vector<std::string> & defines) const
 {
-    const auto source = cgutils::textFromFile(sourceFile.c_str());
+    const auto source = cgutils::injectDefines(cgutils::textFromFile(sourceFile.c_str()), defines);
     const auto source_ptr = source.c_str();
     if (source_ptr)
         glShaderSource(shader, 1, &source_ptr, 0);
@@ -344,7 +748,27 @@ bool Particles::loadShaders()
 
     if (m_computeShadersAvailable)
     {
-        success &= loadShader(m_computeShaders[0], "data/particles/particles.comp");
+        auto updateDefines = std::vector<std::string>{ "GROUP_SIZE " + std::to_string(m_groupSize) };
+        if (!m_forceField.empty())
+            updateDefines.push_back("FORCE_FIELD");
+        success &= loadShader(m_computeShaders[0], "data/particles/particles.comp", updateDefines);
+        success &= loadShader(m_computeShaders[1], "data/particles/fluid-smooth.comp");
+
+        const auto splatDefines = m_int64AtomicsAvailable ? std::vector<std::string>{ "INT64_ATOMICS" } : std::vector<std::string>{};
+        success &= loadShader(m_computeShaders[2], "data/particles/particles-splat.comp", splatDefines);
+        success &= loadShader(m_fragmentShaders[6], "data/particles/particles-splat.frag", splatDefines);
+
+        success &= loadShader(m_computeShaders[3], "data/particles/particles-cull.comp");
+
+        updateDefines.push_back("EMITTER");
+        success &= loadShader(m_computeShaders[4], "data/particles/particles.comp", updateDefines);
+        success &= loadShader(m_computeShaders[5], "data/particles/particles-emit.comp", { "PREPARE" });
+        success &= loadShader(m_computeShaders[6], "data/particles/particles-emit.comp");
+
+        success &= loadShader(m_computeShaders[7], "data/particles/particles-sort.comp", { "KEYS" });
+        success &= loadShader(m_computeShaders[8], "data/particles/particles-sort.comp", { "HISTOGRAM" });
+        success &= loadShader(m_computeShaders[9], "data/particles/particles-sort.comp", { "SCAN" });
+        success &= loadShader(m_computeShaders[10], "data/particles/particles-sort.comp", { "SCATTER" });
     }
 
     success &= loadShader(m_vertexShaders[1],   "data/particles/particles-fluid.vert");
@@ -353,6 +777,13 @@ bool Particles::loadShaders()
 
     success &= loadShader(m_vertexShaders[2], "data/particles/fluid-pass.vert");
     success &= loadShader(m_fragmentShaders[4], "data/particles/fluid-pass.frag");
+    success &= loadShader(m_fragmentShaders[5], "data/particles/fluid-composite.frag");
+
+    success &= loadShader(m_vertexShaders[3], "data/particles/particles-quads.vert");
+    success &= loadShader(m_vertexShaders[4], "data/particles/particles-fluid-quads.vert");
+
+    success &= loadShader(m_vertexShaders[5], "data/particles/particles-quads.vert", { "SORTED" });
+    success &= loadShader(m_fragmentShaders[7], "data/particles/particles-translucent.frag");
 
     glLinkProgram(m_programs[0]);
 
@@ -368,6 +799,39 @@ bool Particles::loadShaders()
     {
         glLinkProgram(m_programs[3]);
         success &= cgutils::checkForLinkerError(m_programs[3], "particles movement program");
+
+        glLinkProgram(m_programs[7]);
+        success &= cgutils::checkForLinkerError(m_programs[7], "fluid smooth program");
+
+        glLinkProgram(m_programs[11]);
+        success &= cgutils::checkForLinkerError(m_programs[11], "particles splat program");
+
+        glLinkProgram(m_programs[12]);
+        success &= cgutils::checkForLinkerError(m_programs[12], "particles splat resolve program");
+
+        glLinkProgram(m_programs[13]);
+        success &= cgutils::checkForLinkerError(m_programs[13], "particles cull program");
+
+        glLinkProgram(m_programs[14]);
+        success &= cgutils::checkForLinkerError(m_programs[14], "particles movement emitter program");
+
+        glLinkProgram(m_programs[15]);
+        success &= cgutils::checkForLinkerError(m_programs[15], "particles emit prepare program");
+
+        glLinkProgram(m_programs[16]);
+        success &= cgutils::checkForLinkerError(m_programs[16], "particles emit program");
+
+        glLinkProgram(m_programs[17]);
+        success &= cgutils::checkForLinkerError(m_programs[17], "particles sort keys program");
+
+        glLinkProgram(m_programs[18]);
+        success &= cgutils::checkForLinkerError(m_programs[18], "particles sort histogram program");
+
+        glLinkProgram(m_programs[19]);
+        success &= cgutils::checkForLinkerError(m_programs[19], "particles sort scan program");
+
+        glLinkProgram(m_programs[20]);
+        success &= cgutils::checkForLinkerError(m_programs[20], "particles sort scatter program");
     }
 
     glLinkProgram(m_programs[4]);
@@ -376,6 +840,21 @@ bool Particles::loadShaders()
     glLinkProgram(m_programs[5]);
     success &= cgutils::checkForLinkerError(m_programs[5], "fluid pass program");
 
+    glLinkProgram(m_programs[6]);
+    success &= cgutils::checkForLinkerError(m_programs[6], "fluid composite program");
+
+    glLinkProgram(m_programs[8]);
+    success &= cgutils::checkForLinkerError(m_programs[8], "particles circle pulling program");
+
+    glLinkProgram(m_programs[9]);
+    success &= cgutils::checkForLinkerError(m_programs[9], "particles sphere pulling program");
+
+    glLinkProgram(m_programs[10]);
+    success &= cgutils::checkForLinkerError(m_programs[10], "particles fluid pulling program");
+
+    glLinkProgram(m_programs[21]);
+    success &= cgutils::checkForLinkerError(m_programs[21], "particles translucent program");
+
     if (!success)
         return false;
 
@@ -410,7 +889,105 @@ void Particles::loadUniformLocations()
     glUseProgram(m_programs[5]); // fluid-pass
     m_uniformLocations[12] = glGetUniformLocation(m_programs[5], "source");
     m_uniformLocations[13] = glGetUniformLocation(m_programs[5], "advance");
-    m_uniformLocations[14] = glGetUniformLocation(m_programs[5], "ndcInverse");
+    m_uniformLocations[16] = glGetUniformLocation(m_programs[5], "radius");
+
+    glUseProgram(m_programs[6]); // fluid-composite
+    m_uniformLocations[14] = glGetUniformLocation(m_programs[6], "source");
+    m_uniformLocations[15] = glGetUniformLocation(m_programs[6], "ndcInverse");
+
+    glUseProgram(m_programs[8]); // circle, vertex pulling
+    m_uniformLocations[20] = glGetUniformLocation(m_programs[8], "transform");
+    m_uniformLocations[21] = glGetUniformLocation(m_programs[8], "scale");
+
+    glUseProgram(m_programs[9]); // sphere, vertex pulling
+    m_uniformLocations[22] = glGetUniformLocation(m_programs[9], "transform");
+    m_uniformLocations[23] = glGetUniformLocation(m_programs[9], "scale");
+
+    glUseProgram(m_programs[10]); // fluid, vertex pulling, same order as 6 to 11
+    m_uniformLocations[24] = glGetUniformLocation(m_programs[10], "view");
+    m_uniformLocations[25] = glGetUniformLocation(m_programs[10], "projection");
+    m_uniformLocations[26] = glGetUniformLocation(m_programs[10], "ndcInverse");
+    m_uniformLocations[27] = glGetUniformLocation(m_programs[10], "scale");
+    m_uniformLocations[28] = glGetUniformLocation(m_programs[10], "normal");
+    m_uniformLocations[29] = glGetUniformLocation(m_programs[10], "eye");
+
+    glUseProgram(m_programs[21]); // translucent
+    m_uniformLocations[59] = glGetUniformLocation(m_programs[21], "transform");
+    m_uniformLocations[60] = glGetUniformLocation(m_programs[21], "scale");
+    m_uniformLocations[61] = glGetUniformLocation(m_programs[21], "order");
+
+    if (m_computeShadersAvailable)
+    {
+        glUseProgram(m_programs[3]); // movement
+        m_uniformLocations[45] = glGetUniformLocation(m_programs[3], "elapsed");
+        m_uniformLocations[46] = glGetUniformLocation(m_programs[3], "integration");
+        m_uniformLocations[47] = glGetUniformLocation(m_programs[3], "elapsedSinceEpoch");
+        m_uniformLocations[48] = glGetUniformLocation(m_programs[3], "count");
+        m_uniformLocations[62] = glGetUniformLocation(m_programs[3], "fieldOrigin");
+        m_uniformLocations[63] = glGetUniformLocation(m_programs[3], "fieldScale");
+        m_uniformLocations[64] = glGetUniformLocation(m_programs[3], "fieldLast");
+        m_uniformLocations[65] = glGetUniformLocation(m_programs[3], "fieldStrength");
+        glUniform1f(glGetUniformLocation(m_programs[3], "friction"), friction);
+        glUniform4fv(glGetUniformLocation(m_programs[3], "gravity"), 1, glm::value_ptr(gravity));
+        glUniform1f(glGetUniformLocation(m_programs[3], "velocityThreshold"), velocityThreshold);
+
+        glUseProgram(m_programs[7]); // fluid-smooth
+        m_uniformLocations[17] = glGetUniformLocation(m_programs[7], "source");
+        m_uniformLocations[18] = glGetUniformLocation(m_programs[7], "advance");
+        m_uniformLocations[19] = glGetUniformLocation(m_programs[7], "radius");
+
+        glUseProgram(m_programs[11]); // splat
+        m_uniformLocations[30] = glGetUniformLocation(m_programs[11], "transform");
+        m_uniformLocations[31] = glGetUniformLocation(m_programs[11], "size");
+        m_uniformLocations[32] = glGetUniformLocation(m_programs[11], "count");
+
+        glUseProgram(m_programs[12]); // splat resolve
+        m_uniformLocations[33] = glGetUniformLocation(m_programs[12], "size");
+
+        glUseProgram(m_programs[13]); // cull
+        m_uniformLocations[34] = glGetUniformLocation(m_programs[13], "transform");
+        m_uniformLocations[35] = glGetUniformLocation(m_programs[13], "extent");
+        m_uniformLocations[36] = glGetUniformLocation(m_programs[13], "minimumRadius");
+        m_uniformLocations[37] = glGetUniformLocation(m_programs[13], "count");
+        m_uniformLocations[38] = glGetUniformLocation(m_programs[13], "verticesPerParticle");
+
+        glUseProgram(m_programs[14]); // movement, emitter variant
+        m_uniformLocations[39] = glGetUniformLocation(m_programs[14], "elapsed");
+        m_uniformLocations[40] = glGetUniformLocation(m_programs[14], "integration");
+        m_uniformLocations[41] = glGetUniformLocation(m_programs[14], "count");
+        m_uniformLocations[66] = glGetUniformLocation(m_programs[14], "fieldOrigin");
+        m_uniformLocations[67] = glGetUniformLocation(m_programs[14], "fieldScale");
+        m_uniformLocations[68] = glGetUniformLocation(m_programs[14], "fieldLast");
+        m_uniformLocations[69] = glGetUniformLocation(m_programs[14], "fieldStrength");
+        glUniform1f(glGetUniformLocation(m_programs[14], "friction"), friction);
+        glUniform4fv(glGetUniformLocation(m_programs[14], "gravity"), 1, glm::value_ptr(gravity));
+        glUniform1f(glGetUniformLocation(m_programs[14], "velocityThreshold"), velocityThreshold);
+
+        glUseProgram(m_programs[15]); // emit prepare
+        m_uniformLocations[42] = glGetUniformLocation(m_programs[15], "budget");
+
+        glUseProgram(m_programs[16]); // emit
+        m_uniformLocations[43] = glGetUniformLocation(m_programs[16], "elapsedSinceEpoch");
+        m_uniformLocations[44] = glGetUniformLocation(m_programs[16], "lifetime");
+
+        glUseProgram(m_programs[17]); // sort keys
+        m_uniformLocations[49] = glGetUniformLocation(m_programs[17], "transform");
+        m_uniformLocations[50] = glGetUniformLocation(m_programs[17], "count");
+        m_uniformLocations[51] = glGetUniformLocation(m_programs[17], "depthRange");
+
+        glUseProgram(m_programs[18]); // sort histogram
+        m_uniformLocations[52] = glGetUniformLocation(m_programs[18], "count");
+        m_uniformLocations[53] = glGetUniformLocation(m_programs[18], "shift");
+        m_uniformLocations[54] = glGetUniformLocation(m_programs[18], "tiles");
+
+        glUseProgram(m_programs[19]); // sort scan
+        m_uniformLocations[55] = glGetUniformLocation(m_programs[19], "tiles");
+
+        glUseProgram(m_programs[20]); // sort scatter
+        m_uniformLocations[56] = glGetUniformLocation(m_programs[20], "count");
+        m_uniformLocations[57] = glGetUniformLocation(m_programs[20], "shift");
+        m_uniformLocations[58] = glGetUniformLocation(m_programs[20], "tiles");
+    }
 
     glUseProgram(0);
 }
@@ -424,13 +1001,21 @@ void Particles::resize(int w, int h)
 
 void Particles::resizeTextures()
 {
+    m_fluidWidth = std::max(1, static_cast<int>(m_width * m_fluidScale + 0.5f));
+    m_fluidHeight = std::max(1, static_cast<int>(m_height * m_fluidScale + 0.5f));
+
     glBindTexture(GL_TEXTURE_2D, m_textures[0]);
     //glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_width, m_height, 0, GL_RED, GL_FLOAT, nullptr);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_fluidWidth, m_fluidHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
     glBindTexture(GL_TEXTURE_2D, m_textures[1]);
-    //glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_width, m_height, 0, GL_RED, GL_FLOAT, nullptr);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_fluidWidth, m_fluidHeight, 0, GL_RED, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, m_textures[2]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_fluidWidth, m_fluidHeight, 0, GL_RED, GL_FLOAT, nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_splatBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (m_int64AtomicsAvailable ? 8 : 4) * m_width * m_height, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     
     //glBindRenderbuffer(GL_RENDERBUFFER, m_renderBuffers[0]);
     //glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
@@ -439,314 +1024,1316 @@ void Particles::resizeTextures()
     //glBindRenderbuffer(GL_RENDERBUFFER, 0);
 }
 
-void Particles::pause()
+float Particles::fluidScale() const
 {
-    m_paused = !m_paused;
-    elapsed();
+    return m_fluidScale;
 }
 
-void Particles::benchmark()
+void Particles::setFluidScale(const float scale)
 {
-    m_measure = true;
+    m_fluidBudget = 0.f;
 
-    m_measureCount = 0;
-    m_measureTime0 = m_time;
-}
+    const auto quantized = std::round(glm::clamp(scale, minimumFluidScale, 1.f) / fluidScaleStep) * fluidScaleStep;
+    if (quantized == m_fluidScale)
+        return;
 
-void Particles::setProcessing(const ProcessingMode mode)
-{
-    // switch from GPU to CPU -> copy back position and velocity information
-    if (m_processingMode == ProcessingMode::GPU_ComputeShaders
-        && mode != ProcessingMode::GPU_ComputeShaders)
-    {
-        glBindBuffer(GL_COPY_READ_BUFFER, m_vbos[0]);
-        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(glm::vec4) * m_num, m_positions.data());
+    m_fluidScale = quantized;
+    m_fluidFramesSinceChange = 0;
 
-        glBindBuffer(GL_COPY_READ_BUFFER, m_vbos[1]);
-        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(glm::vec4) * m_num, m_velocities.data());
+    if (m_initialized)
+        resizeTextures();
+}
 
-        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+void Particles::setFluidBudget(const float milliseconds)
+{
+    m_fluidBudget = milliseconds > 0.f ? milliseconds : 0.f;
+    m_fluidFramesSinceChange = 0;
+}
 
-        if (m_bufferStorageAvailable)
-        {
-            setupBuffer(true, m_bufferStorageAvailable);
-        }
-    }
+float Particles::fluidTime() const
+{
+    return m_drawMode == DrawingMode::Fluid ? m_drawTime : 0.f;
+}
 
-    // switch from CPU to GPU -> copy velocity information
-    // (positions of the last frame are expected to be on gpu anyway)
-    if (m_processingMode != ProcessingMode::GPU_ComputeShaders
-        && mode == ProcessingMode::GPU_ComputeShaders)
-    {
-        glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[1]);
-        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(glm::vec4) * m_num, m_velocities.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+float Particles::drawTime() const
+{
+    return m_drawTime;
+}
 
-        if (m_bufferStorageAvailable)
-        {
-            setupBuffer(false, m_bufferStorageAvailable);
+float Particles::sortTime() const
+{
+    return m_sortTime;
+}
 
-            glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[0]);
-            glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(glm::vec4) * m_num, m_positions.data());
-            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
-        }
-    }
+bool Particles::vertexPulling() const
+{
+    return m_vertexPulling;
+}
 
-    m_processingMode = mode;
+void Particles::setVertexPulling(const bool enable)
+{
+    m_vertexPulling = enable;
 }
 
-void Particles::setDrawing(const DrawingMode mode)
+bool Particles::vertexPullingActive() const
 {
-    m_drawMode = mode;
+    return m_vertexPulling && m_active <= m_maxBufferTexels;
 }
 
-float Particles::scale()
+bool Particles::gpuCulling() const
 {
-    return m_radius;
+    return m_gpuCulling;
 }
 
-void Particles::setScale(const float scale)
+void Particles::setGpuCulling(const bool enable)
 {
-    m_radius = glm::clamp(scale, 1.f, 1024.f);
+    m_gpuCulling = enable;
 }
 
-float Particles::angle() const
+float Particles::cullRadius() const
 {
-    return m_angle;
+    return m_cullRadius;
 }
 
-void Particles::rotate(const float angle)
+void Particles::setCullRadius(const float pixels)
 {
-    m_angle = angle;
+    m_cullRadius = glm::max(pixels, 0.f);
 }
 
-void Particles::spawn(const std::uint32_t index)
+void Particles::cull(const glm::mat4 & transform, const glm::vec2 & extent, const bool pulling)
 {
-    const auto r = glm::normalize(glm::vec4(frand(rd), frand(rd), frand(rd), 0.0f));
+    if (m_visibleCapacity < m_active)
+    {
+        m_visibleCapacity = m_num;
 
-    const auto e = m_elapsedSinceEpoch * 10.f;
+        glBindBuffer(GL_ARRAY_BUFFER, m_visibleBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_visibleCapacity, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-    m_velocities[index] = r * (frand(rd) * 0.5f + 0.5f) + glm::vec4(
-        4.f * sin(0.121031f * e), 4.f + (frand(rd)) * sin(e * 0.618709f), 4.f * sin(e * 0.545545f), 0.0f);
+    static const std::uint32_t reset[] = { 0, 1, 0, 0 }; // count, instance count, first, base instance
 
-    m_positions[index] = r * 0.1f + glm::vec4(0.0f, 0.2f, 0.0f, 1.0f);
-}
+    glBindBuffer(GL_ARRAY_BUFFER, m_commandBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(reset), reset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-void Particles::prepare()
-{
-    m_positions.resize(m_num);
-    m_velocities.resize(m_num);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, m_vbos[0]);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 3, m_visibleBuffer);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 4, m_commandBuffer);
 
-#pragma omp parallel for
-    for (auto i = 0; i < m_num; ++i)
-        spawn(i);
+    const auto groups = (m_active + cullGroupSize - 1) / cullGroupSize;
+    const auto groupsX = glm::min(groups, maximumGroupCount);
+    const auto groupsY = groupsX > 0 ? (groups + groupsX - 1) / groupsX : 0;
 
-    elapsed();
-}
+    glUseProgram(m_programs[13]);
 
-float Particles::elapsed()
-{
-    const auto t0 = m_time;
-    m_time = std::chrono::high_resolution_clock::now();
+    glUniformMatrix4fv(m_uniformLocations[34], 1, GL_FALSE, glm::value_ptr(transform));
+    glUniform2fv(m_uniformLocations[35], 1, glm::value_ptr(extent));
+    glUniform1f(m_uniformLocations[36], m_cullRadius);
+    glUniform1i(m_uniformLocations[37], m_active);
+    glUniform1ui(m_uniformLocations[38], pulling ? 6u : 1u);
 
-    m_elapsedSinceEpoch = secs(m_time - m_time0).count();
-    const auto elapsedSinceLast = secs(m_time - t0).count();
+    gl32ext::glDispatchCompute(groupsX, groupsY, 1);
+    gl32ext::glMemoryBarrier(gl::GL_COMMAND_BARRIER_BIT | gl::GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | gl::GL_TEXTURE_FETCH_BARRIER_BIT);
 
-    return elapsedSinceLast;
+    glUseProgram(0);
+
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 3, 0);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 4, 0);
 }
 
-void Particles::process(float elapsed)
+void Particles::drawParticles(const bool pulling)
 {
-    const auto elapsed2 = elapsed * elapsed;
+    const auto culled = m_gpuCulling && m_computeShadersAvailable;
 
-    for (auto i = 0; i < static_cast<std::int32_t>(m_num); ++i)
+    if (pulling)
     {
-        auto & p = m_positions[i];
-        auto & v = m_velocities[i];
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, m_positionTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, culled ? m_visibleBuffer : m_vbos[0]);
 
-        const auto f = gravity - v * friction;
+        glBindVertexArray(m_vaos[2]);
+    }
+    else
+        glBindVertexArray(culled ? m_vaos[3] : m_vaos[0]);
+
+    const auto mode = pulling ? GL_TRIANGLES : GL_POINTS;
+
+    if (culled)
+    {
+        glBindBuffer(gl::GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+        gl32ext::glDrawArraysIndirect(mode, nullptr);
+        glBindBuffer(gl::GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+        glDrawArrays(mode, 0, pulling ? m_active * 6 : m_active);
+
+    glBindVertexArray(0);
+
+    if (pulling)
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void Particles::sort(const glm::mat4 & transform)
+{
+    const auto tiles = (m_active + sortTileSize - 1) / sortTileSize;
+
+    if (m_sortCapacity < m_active)
+    {
+        m_sortCapacity = m_num;
+        const auto capacityTiles = (m_sortCapacity + sortTileSize - 1) / sortTileSize;
+
+        for (auto i = 0; i < 2; ++i)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, m_sortKeys[i]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(std::uint32_t) * m_sortCapacity, nullptr, GL_DYNAMIC_COPY);
+            glBindBuffer(GL_ARRAY_BUFFER, m_sortValues[i]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(std::uint32_t) * m_sortCapacity, nullptr, GL_DYNAMIC_COPY);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_sortHistogram);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(std::uint32_t) * sortRadix * capacityTiles, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // keys from view depth and values from indices, into the first buffers
+
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, m_vbos[0]);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 3, m_sortKeys[0]);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 4, m_sortValues[0]);
+
+    glUseProgram(m_programs[17]);
+
+    glUniformMatrix4fv(m_uniformLocations[49], 1, GL_FALSE, glm::value_ptr(transform));
+    glUniform1i(m_uniformLocations[50], m_active);
+    glUniform2fv(m_uniformLocations[51], 1, glm::value_ptr(depthRange));
+
+    gl32ext::glDispatchCompute(glm::min((m_active + sortGroupSize - 1) / sortGroupSize, maximumGroupCount), 1, 1);
+    gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // one histogram, scan, and scatter per digit, alternating between the buffers
+
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 5, m_sortHistogram);
+
+    for (auto pass = 0; pass < sortPasses; ++pass)
+    {
+        const auto source = pass % 2;
+        const auto shift = static_cast<GLuint>(pass * 8);
+
+        glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 1, m_sortKeys[source]);
+        glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 2, m_sortValues[source]);
+        glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 3, m_sortKeys[1 - source]);
+        glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 4, m_sortValues[1 - source]);
+
+        glUseProgram(m_programs[18]);
+        glUniform1i(m_uniformLocations[52], m_active);
+        glUniform1ui(m_uniformLocations[53], shift);
+        glUniform1i(m_uniformLocations[54], tiles);
+
+        gl32ext::glDispatchCompute(tiles, 1, 1);
+        gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glUseProgram(m_programs[19]);
+        glUniform1i(m_uniformLocations[55], tiles);
+
+        gl32ext::glDispatchCompute(1, 1, 1);
+        gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glUseProgram(m_programs[20]);
+        glUniform1i(m_uniformLocations[56], m_active);
+        glUniform1ui(m_uniformLocations[57], shift);
+        glUniform1i(m_uniformLocations[58], tiles);
+
+        gl32ext::glDispatchCompute(tiles, 1, 1);
+        gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT | gl::GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    glUseProgram(0);
+
+    for (auto binding = 0u; binding < 6u; ++binding)
+        glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, binding, 0);
+}
+
+int Particles::fluidRadius() const
+{
+    return m_fluidRadius;
+}
+
+void Particles::setFluidRadius(const int radius)
+{
+    m_fluidRadius = glm::clamp(radius, 0, maximumFluidRadius);
+}
+
+bool Particles::fluidCompute() const
+{
+    return m_fluidCompute;
+}
+
+void Particles::setFluidCompute(const bool compute)
+{
+    m_fluidCompute = compute;
+}
+
+void Particles::updateFluidScale()
+{
+    if (m_fluidBudget <= 0.f || m_drawTime <= 0.f || ++m_fluidFramesSinceChange < fluidSettleFrames)
+        return;
+
+    // the cost scales with the pixel count, i.e., quadratically with the scale
+    auto scale = m_fluidScale;
+    if (m_drawTime > m_fluidBudget * fluidDegradeThreshold)
+        scale -= fluidScaleStep;
+    else if (m_drawTime < m_fluidBudget * fluidUpgradeThreshold)
+        scale += fluidScaleStep;
+
+    scale = glm::clamp(scale, minimumFluidScale, 1.f);
+    if (scale == m_fluidScale)
+        return;
+
+    m_fluidScale = scale;
+    m_fluidFramesSinceChange = 0;
+
+    resizeTextures();
+}
+
+void Particles::pause()
+{
+    m_paused = !m_paused;
+    elapsed();
+}
+
+void Particles::benchmark()
+{
+    m_measure = true;
+    resetCounters();
+
+    m_measureCount = 0;
+    m_measureTime0 = m_time;
+}
+
+int Particles::threads() const
+{
+    return m_threads;
+}
+
+void Particles::setThreads(const int threads)
+{
+    m_threads = threads > 0 ? threads : 0;
+
+#ifdef USE_OPENMP
+    omp_set_num_threads(m_threads > 0 ? m_threads : omp_get_num_procs());
+#endif
+}
+
+int Particles::chunkSize() const
+{
+    return m_chunkSize;
+}
+
+void Particles::setChunkSize(const int chunkSize)
+{
+    m_chunkSize = chunkSize > 0 ? chunkSize : 0;
+
+#ifdef USE_OPENMP
+    // chunk size 0 keeps the default static partition into equally sized chunks
+    omp_set_schedule(omp_sched_static, m_chunkSize);
+#endif
+}
+
+int Particles::computeGroupSize() const
+{
+    return m_groupSize;
+}
+
+int Particles::computeParticlesPerThread() const
+{
+    return m_particlesPerThread;
+}
+
+int Particles::maxComputeGroupSize() const
+{
+    return m_maxGroupSize;
+}
+
+void Particles::setComputeConfiguration(const int groupSize, const int particlesPerThread)
+{
+    const auto size = glm::clamp(groupSize > 0 ? groupSize : defaultGroupSize, 1, m_maxGroupSize);
+    m_particlesPerThread = particlesPerThread > 0 ? particlesPerThread : 1;
+
+    if (size == m_groupSize)
+        return;
+
+    m_groupSize = size;
+
+    // the work group size is a compile time constant of the update kernels
+    if (m_initialized && m_computeShadersAvailable)
+        loadShaders();
+}
+
+float Particles::openingAngle() const
+{
+    return m_barnesHut.openingAngle();
+}
+
+void Particles::setOpeningAngle(const float theta)
+{
+    m_barnesHut.setOpeningAngle(theta);
+}
+
+float Particles::attraction() const
+{
+    return m_barnesHut.strength();
+}
+
+void Particles::setAttraction(const float strength)
+{
+    m_barnesHut.setStrength(strength);
+}
+
+Colliders & Particles::colliders()
+{
+    return m_colliders;
+}
+
+bool Particles::loadColliders(const std::string & filePath)
+{
+    m_colliders.clear();
+    return m_colliders.load(filePath);
+}
+
+const ForceField & Particles::forceField() const
+{
+    return m_forceField;
+}
+
+bool Particles::loadForceField(const std::string & rawFile, const glm::ivec3 & resolution, const glm::vec3 & origin, const float spacing)
+{
+    const auto success = m_forceField.load(rawFile, resolution, origin, spacing);
+    updateForceField();
+    return success;
+}
+
+void Particles::generateForceField(const glm::ivec3 & resolution, const glm::vec3 & origin, const float spacing, const float frequency)
+{
+    m_forceField.generateCurlNoise(resolution, origin, spacing, frequency);
+    updateForceField();
+}
+
+void Particles::setForceFieldStrength(const float strength)
+{
+    m_forceField.setStrength(strength);
+}
+
+void Particles::clearForceField()
+{
+    m_forceField.clear();
+    updateForceField();
+}
+
+void Particles::updateForceField()
+{
+    if (!m_initialized || !m_computeShadersAvailable)
+        return;
+
+    if (!m_forceField.empty())
+        uploadForceField();
+
+    // sampling the field is a compile time option of the update kernels
+    loadShaders();
+}
+
+void Particles::uploadForceField()
+{
+    const auto & resolution = m_forceField.resolution();
+
+    // half floats halve the memory and bandwidth, their precision suffices for accelerations
+    glBindTexture(GL_TEXTURE_3D, m_fieldTexture);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, resolution.x, resolution.y, resolution.z, 0, GL_RGB, GL_FLOAT, nullptr);
+
+    auto slice = std::vector<float>();
+    for (auto z = 0; z < resolution.z; ++z)
+    {
+        m_forceField.slice(z, slice);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, z, resolution.x, resolution.y, 1, GL_RGB, GL_FLOAT, slice.data());
+    }
+
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(GL_LINEAR));
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(GL_LINEAR));
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, static_cast<GLint>(GL_CLAMP_TO_EDGE));
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, static_cast<GLint>(GL_CLAMP_TO_EDGE));
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, static_cast<GLint>(GL_CLAMP_TO_EDGE));
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+Integration::Scheme Particles::integrator() const
+{
+    return m_integrator;
+}
+
+void Particles::setIntegrator(const Integration::Scheme scheme)
+{
+    m_integrator = scheme;
+}
+
+float Particles::maxStep() const
+{
+    return m_maxStep;
+}
+
+void Particles::setMaxStep(const float seconds)
+{
+    m_maxStep = seconds > 0.f ? seconds : defaultMaxStep;
+}
+
+bool Particles::enableCounters()
+{
+    return m_counters.open();
+}
+
+void Particles::resetCounters()
+{
+    m_counters.reset();
+    m_countedParticles = 0;
+    m_countedTime = 0;
+}
+
+void Particles::reportCounters(cgutils::BenchmarkResult & result) const
+{
+    using Event = cgutils::PerfCounters::Event;
+
+    if (m_countedParticles == 0)
+        return;
+
+    const auto particles = static_cast<double>(m_countedParticles);
+
+    result.setMetric("processed_particles", particles);
+    result.setMetric("process_ns_per_particle", m_countedTime / particles);
+    result.setMetric("nominal_bytes_per_particle", static_cast<double>(bytesPerParticle(m_processingMode)));
+    result.setMetric("resident_bytes_per_particle", static_cast<double>(residentBytesPerParticle()));
+
+    if (!m_counters.available())
+        return;
+
+    const auto cycles = static_cast<double>(m_counters.value(Event::Cycles));
+    const auto instructions = static_cast<double>(m_counters.value(Event::Instructions));
+
+    if (m_counters.available(Event::Cycles) && m_counters.available(Event::Instructions) && cycles > 0.0)
+        result.setMetric("ipc", instructions / cycles);
+    if (m_counters.available(Event::Cycles))
+        result.setMetric("cycles_per_particle", cycles / particles);
+    if (m_counters.available(Event::Instructions))
+        result.setMetric("instructions_per_particle", instructions / particles);
+    if (m_counters.available(Event::LLCMisses))
+    {
+        const auto misses = m_counters.value(Event::LLCMisses) / particles;
+        result.setMetric("llc_misses_per_particle", misses);
+        // memory traffic estimated by last level cache misses of 64 byte lines
+        result.setMetric("bytes_per_particle", misses * 64.0);
+    }
+    if (m_counters.available(Event::DTLBMisses))
+        result.setMetric("dtlb_misses_per_particle", m_counters.value(Event::DTLBMisses) / particles);
+    if (m_counters.available(Event::BranchMisses))
+        result.setMetric("branch_misses_per_particle", m_counters.value(Event::BranchMisses) / particles);
+}
+
+bool Particles::setProcessing(const ProcessingMode mode)
+{
+    // modes not built or not supported by the context keep the current mode
+    if (!available(mode))
+        return false;
+
+    // switch from compact storage -> expand into positions and velocities first
+    if (m_processingMode == ProcessingMode::CPU_OMP_Compact
+        && mode != ProcessingMode::CPU_OMP_Compact)
+    {
+        unpackStorage();
+    }
+
+    // switch from GPU to CPU -> copy back position and velocity information
+    if (m_processingMode == ProcessingMode::GPU_ComputeShaders
+        && mode != ProcessingMode::GPU_ComputeShaders)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, m_vbos[0]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(glm::vec4) * m_num, m_positions.data());
+
+        glBindBuffer(GL_COPY_READ_BUFFER, m_vbos[1]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(glm::vec4) * m_num, m_velocities.data());
+
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        if (m_bufferStorageAvailable)
+        {
+            setupBuffer(true, m_bufferStorageAvailable);
+        }
+
+        // dead particles are parked, the CPU modes respawn in place
+        if (m_emitRate > 0.f)
+            prepare();
+    }
+
+    // switch from CPU to GPU -> copy velocity information
+    // (positions of the last frame are expected to be on gpu anyway)
+    if (m_processingMode != ProcessingMode::GPU_ComputeShaders
+        && mode == ProcessingMode::GPU_ComputeShaders)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[1]);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(glm::vec4) * m_num, m_velocities.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        if (m_bufferStorageAvailable)
+        {
+            setupBuffer(false, m_bufferStorageAvailable);
+
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[0]);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(glm::vec4) * m_num, m_positions.data());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        if (m_emitRate > 0.f)
+            resetEmitter();
+    }
+
+    // switch to compact storage -> pack and release positions and velocities
+    if (m_processingMode != ProcessingMode::CPU_OMP_Compact
+        && mode == ProcessingMode::CPU_OMP_Compact)
+    {
+        packStorage();
+    }
+
+    m_processingMode = mode;
+    return true;
+}
+
+void Particles::setDrawing(const DrawingMode mode)
+{
+    m_drawMode = mode;
+}
+
+bool Particles::available(const ProcessingMode mode) const
+{
+    switch (mode)
+    {
+    case ProcessingMode::CPU_OMP_AVX2:
+#ifdef BUILD_WITH_AVX2
+        return true;
+#else
+        return false;
+#endif
+    case ProcessingMode::CPU_OMP_AVX512:
+#ifdef BUILD_WITH_AVX512
+        return true;
+#else
+        return false;
+#endif
+    case ProcessingMode::CPU_OMP_Compact:
+#ifdef BUILD_WITH_AVX2
+        return true;
+#else
+        return false;
+#endif
+    case ProcessingMode::GPU_ComputeShaders:
+        return m_computeShadersAvailable;
+    default:
+        return true;
+    }
+}
+
+void Particles::step(const ProcessingMode mode, const float elapsed)
+{
+    if (mode != m_processingMode && !setProcessing(mode))
+        return;
+
+    if (mode == ProcessingMode::GPU_ComputeShaders)
+    {
+        processComputeShaders(elapsed);
+        glFinish();
+    }
+    else if (mode == ProcessingMode::CPU_OMP_Compact)
+        processCompact(elapsed);
+    else
+        processCPU(mode, elapsed);
+}
+
+float Particles::deviation(const ProcessingMode mode, const float elapsed)
+{
+    // the compact storage holds no vec4 state to compare against
+    if (mode == ProcessingMode::GPU_ComputeShaders || mode == ProcessingMode::CPU_OMP_Compact || !available(mode)
+        || m_processingMode == ProcessingMode::CPU_OMP_Compact)
+        return -1.f;
+
+    if (mode == ProcessingMode::CPU_OMP_BarnesHut)
+    {
+        m_accelerations.resize(m_active);
+        m_barnesHut.accelerations(m_positions.data(), m_active, m_accelerations.data(), static_cast<unsigned int>(std::max(0, m_threads)));
+    }
+    const auto accelerations = mode == ProcessingMode::CPU_OMP_BarnesHut ? m_accelerations.data() : nullptr;
+
+    const auto positions = m_positions;
+    const auto velocities = m_velocities;
+
+    integrate<ScalarBatch>(elapsed, accelerations, false);
+    const auto referencePositions = m_positions;
+    const auto referenceVelocities = m_velocities;
+
+    m_positions = positions;
+    m_velocities = velocities;
+    integrate(mode, elapsed);
+
+    auto deviation = 0.f;
+    for (auto i = 0; i < m_active; ++i)
+    {
+        const auto dp = m_positions[i] - referencePositions[i];
+        const auto dv = m_velocities[i] - referenceVelocities[i];
+        deviation = std::max({ deviation, std::abs(dp.x), std::abs(dp.y), std::abs(dp.z), std::abs(dv.x), std::abs(dv.y), std::abs(dv.z) });
+    }
+
+    m_positions = positions;
+    m_velocities = velocities;
+
+    return deviation;
+}
+
+std::size_t Particles::bytesPerParticle(const ProcessingMode mode)
+{
+    // compact positions and velocities are read and written once, respawn is part of the pass
+    if (mode == ProcessingMode::CPU_OMP_Compact)
+        return 2 * (sizeof(glm::vec3) + 3 * sizeof(std::uint16_t));
+
+    // positions and velocities are read and written, positions are read again for respawn
+    return 5 * sizeof(glm::vec4);
+}
+
+std::size_t Particles::residentBytesPerParticle() const
+{
+    // the GL buffers hold positions (drawing) and, for the compute shaders, velocities as vec4
+    const auto gl = (m_processingMode == ProcessingMode::GPU_ComputeShaders ? 2 : 1) * sizeof(glm::vec4);
+
+    const auto compact = sizeof(glm::vec3) + 3 * sizeof(std::uint16_t);
+    const auto cpu = m_processingMode == ProcessingMode::CPU_OMP_Compact ? compact : 2 * sizeof(glm::vec4);
+
+    return cpu + gl;
+}
+
+std::size_t Particles::flopsPerParticle()
+{
+    // position 12, velocity 9, and squared speed 5 (ignoring the ground bounce)
+    return 26;
+}
+
+Particles::ProcessingMode Particles::processing() const
+{
+    return m_processingMode;
+}
+
+Particles::DrawingMode Particles::drawing() const
+{
+    return m_drawMode;
+}
+
+std::int32_t Particles::numParticles() const
+{
+    return m_num;
+}
+
+std::int32_t Particles::numActiveParticles() const
+{
+    return m_active;
+}
+
+void Particles::setFrameBudget(const float milliseconds)
+{
+    m_governor.setBudget(milliseconds);
+    applyQuality();
+}
+
+const Governor & Particles::governor() const
+{
+    return m_governor;
+}
+
+void Particles::applyQuality()
+{
+    m_active = glm::max(1, static_cast<std::int32_t>(m_num * m_governor.settings().activeFraction));
+}
+
+bool Particles::respawnDue()
+{
+    return m_steps++ % m_governor.settings().respawnStride == 0;
+}
+
+void Particles::setNumParticles(const std::int32_t num)
+{
+    if (num == m_num || num < 1)
+        return;
+
+    m_num = num;
+    applyQuality();
+
+    // resources are setup with the current count on initialize
+    if (!m_initialized)
+        return;
+
+    prepare();
+
+    const auto gpu = m_processingMode == ProcessingMode::GPU_ComputeShaders;
+    setupBuffer(!gpu, m_bufferStorageAvailable);
+
+    if (!gpu)
+        return;
+
+    upload();
+
+    if (m_emitRate > 0.f)
+        resetEmitter();
+}
+
+void Particles::upload()
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[0]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(glm::vec4) * m_num, m_positions.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[1]);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(glm::vec4) * m_num, m_velocities.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+float Particles::emitRate() const
+{
+    return m_emitRate;
+}
+
+float Particles::emitLifetime() const
+{
+    return m_emitLifetime;
+}
+
+void Particles::setEmitter(const float rate, const float lifetime)
+{
+    const auto enabled = m_emitRate > 0.f;
+
+    m_emitRate = glm::max(rate, 0.f);
+    m_emitLifetime = glm::max(lifetime, 0.f);
+
+    if (!m_initialized || m_processingMode != ProcessingMode::GPU_ComputeShaders || enabled == (m_emitRate > 0.f))
+        return;
+
+    // all particles start dead with the emitter and alive without
+    if (m_emitRate > 0.f)
+        resetEmitter();
+    else
+    {
+        prepare();
+        upload();
+    }
+}
+
+void Particles::resetEmitter()
+{
+    const auto parked = std::vector<glm::vec4>(m_num, parkedPosition);
+    const auto resting = std::vector<glm::vec4>(m_num, glm::vec4(0.f));
+
+    auto dead = std::vector<std::uint32_t>(m_num);
+    std::iota(dead.begin(), dead.end(), 0u);
+
+    const std::uint32_t emitter[] = { static_cast<std::uint32_t>(m_num), 0, 0, 1, 1 }; // dead count, emit count, groups
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[0]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(glm::vec4) * m_num, parked.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbos[1]);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(glm::vec4) * m_num, resting.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_deadBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(std::uint32_t) * m_num, dead.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_emitterBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(emitter), emitter, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_emitBudget = 0.f;
+}
+
+std::string Particles::toString(const ProcessingMode mode)
+{
+    return processingModeNames[static_cast<size_t>(mode)];
+}
+
+std::string Particles::toString(const DrawingMode mode)
+{
+    return drawingModeNames[static_cast<size_t>(mode)];
+}
+
+bool Particles::fromString(const std::string & name, ProcessingMode & mode)
+{
+    for (auto i = size_t{ 0 }; i < processingModeNames.size(); ++i)
+    {
+        if (processingModeNames[i] != name)
+            continue;
+
+        mode = static_cast<ProcessingMode>(i);
+        return true;
+    }
+    return false;
+}
+
+bool Particles::fromString(const std::string & name, DrawingMode & mode)
+{
+    for (auto i = size_t{ 0 }; i < drawingModeNames.size(); ++i)
+    {
+        if (drawingModeNames[i] != name)
+            continue;
+
+        mode = static_cast<DrawingMode>(i);
+        return true;
+    }
+    return false;
+}
+
+float Particles::scale()
+{
+    return m_radius;
+}
+
+void Particles::setScale(const float scale)
+{
+    m_radius = glm::clamp(scale, 1.f, 1024.f);
+}
 
-        p += (v * elapsed) + (0.5f * f * elapsed2);
-        v += (f * elapsed);
+float Particles::angle() const
+{
+    return m_angle;
+}
 
-        if (p.y < 0.f)
-        {
-            p.y *= -1.f;
-            v.y *= -1.f;
+void Particles::rotate(const float angle)
+{
+    m_angle = angle;
+}
 
-            v *= 1.0 - friction;
-        }
+void Particles::spawn(const std::uint32_t index)
+{
+    spawn(m_positions[index], m_velocities[index]);
+}
 
-        p.w = glm::dot(glm::vec3(v), glm::vec3(v));
-    }
+void Particles::spawn(glm::vec4 & position, glm::vec4 & velocity) const
+{
+    const auto r = glm::normalize(glm::vec4(frand(rd), frand(rd), frand(rd), 0.0f));
+
+    const auto e = m_elapsedSinceEpoch * 10.f;
+
+    velocity = r * (frand(rd) * 0.5f + 0.5f) + glm::vec4(
+        4.f * sin(0.121031f * e), 4.f + (frand(rd)) * sin(e * 0.618709f), 4.f * sin(e * 0.545545f), 0.0f);
+
+    position = r * 0.1f + glm::vec4(0.0f, 0.2f, 0.0f, 1.0f);
+}
+
+void Particles::prepare()
+{
+    m_positions.resize(m_num);
+    m_velocities.resize(m_num);
 
+#pragma omp parallel for schedule(runtime)
     for (auto i = 0; i < m_num; ++i)
+        spawn(i);
+
+    // spawned in vec4 for simplicity, the peak is temporary
+    if (m_processingMode == ProcessingMode::CPU_OMP_Compact)
+        packStorage();
+
+    elapsed();
+}
+
+float Particles::elapsed()
+{
+    const auto t0 = m_time;
+    m_time = std::chrono::high_resolution_clock::now();
+
+    m_elapsedSinceEpoch = secs(m_time - m_time0).count();
+    const auto elapsedSinceLast = secs(m_time - t0).count();
+
+    return elapsedSinceLast;
+}
+
+void Particles::processCPU(const ProcessingMode mode, const float elapsed)
+{
+    if (mode == ProcessingMode::CPU_OMP_BarnesHut)
     {
-        if (m_positions[i].w < velocityThreshold)
-            spawn(i);
+        m_accelerations.resize(m_active);
+        m_barnesHut.accelerations(m_positions.data(), m_active, m_accelerations.data(), static_cast<unsigned int>(std::max(0, m_threads)));
     }
+
+    integrate(mode, elapsed);
+    finish(mode != ProcessingMode::CPU);
 }
 
-void Particles::processOMP(float elapsed)
+void Particles::integrate(const ProcessingMode mode, const float elapsed)
 {
-    const auto elapsed2 = elapsed * elapsed;
-
-#pragma omp parallel for
-    for (auto i = 0; i < static_cast<std::int32_t>(m_num); ++i)
+    switch (mode)
     {
-        auto & p = m_positions[i];
-        auto & v = m_velocities[i];
+    case ProcessingMode::CPU:
+        integrate<ScalarBatch>(elapsed, nullptr, false);
+        break;
+    case ProcessingMode::CPU_OMP:
+        integrate<ScalarBatch>(elapsed, nullptr, true);
+        break;
+    case ProcessingMode::CPU_OMP_SSE41:
+        integrate<simd::batch<float, 4, simd::SSE41>>(elapsed, nullptr, true);
+        break;
+#ifdef BUILD_WITH_AVX2
+    case ProcessingMode::CPU_OMP_AVX2:
+        integrate<simd::batch<float, 8, simd::AVX2>>(elapsed, nullptr, true);
+        break;
+#endif
+#ifdef BUILD_WITH_AVX512
+    case ProcessingMode::CPU_OMP_AVX512:
+        integrate<simd::batch<float, 16, simd::AVX512>>(elapsed, nullptr, true);
+        break;
+#endif
+    case ProcessingMode::CPU_OMP_BarnesHut:
+        integrate<WidestBatch>(elapsed, m_accelerations.data(), true);
+        break;
+    default:
+        break;
+    }
+}
+
+template <typename Batch>
+void Particles::integrate(const float elapsed, const glm::vec4 * accelerations, const bool parallel)
+{
+    const auto step = Integration(m_integrator, elapsed, friction);
+    const auto field = !m_forceField.empty();
+
+    // blocks of particles whose accelerations are gathered first, then integrated per batch
 
-        const auto f = gravity - v * friction;
+    const auto blocks = m_active / blockSize;
 
-        p += (v * elapsed) + (0.5f * f * elapsed2);
-        v += (f * elapsed);
+#pragma omp parallel for schedule(runtime) if(parallel)
+    for (auto i = 0; i < blocks; ++i)
+    {
+        // per block, as the members of a shared kernel could alias the particles for the compiler
+        const auto kernel = Kernel<Batch>(step);
+
+        const auto first = i * blockSize;
+        const float * a = accelerations ? glm::value_ptr(accelerations[first]) : nullptr;
 
-        if (p.y < 0.f)
+        alignas(64) glm::vec4 samples[blockSize];
+        if (field)
         {
-            p.y *= -1.f;
-            v.y *= -1.f;
+            auto j = 0;
+#ifdef BUILD_WITH_AVX2
+            // gather by AVX2 only for the wide kernels, the narrower ones stay within their instruction set
+            for (; Batch::size >= 8 && j < blockSize; j += 8)
+                m_forceField.sample8(&m_positions[first + j], &samples[j]);
+#endif
+            for (; j < blockSize; ++j)
+                samples[j] = m_forceField.sample(m_positions[first + j]);
 
-            v *= 1.0 - friction;
+            for (j = 0; accelerations && j < blockSize; ++j)
+                samples[j] += accelerations[first + j];
+
+            a = glm::value_ptr(samples[0]);
         }
 
-        p.w = glm::dot(glm::vec3(v), glm::vec3(v));
+        auto p = glm::value_ptr(m_positions[first]);
+        auto v = glm::value_ptr(m_velocities[first]);
+        for (auto j = 0; j < 4 * blockSize; j += static_cast<int>(Batch::size))
+            kernel(p + j, v + j, a ? a + j : nullptr);
     }
 
-#pragma omp parallel for
-    for (auto i = 0; i < m_num; ++i)
+    // remaining particles one by one
+
+    const auto tail = Kernel<ScalarBatch>(step);
+    for (auto i = blocks * blockSize; i < m_active; ++i)
+    {
+        auto a = glm::vec4(0.f);
+        if (field)
+            a += m_forceField.sample(m_positions[i]);
+        if (accelerations)
+            a += accelerations[i];
+
+        tail(glm::value_ptr(m_positions[i]), glm::value_ptr(m_velocities[i]), field || accelerations ? glm::value_ptr(a) : nullptr);
+    }
+}
+
+void Particles::finish(const bool parallel)
+{
+    m_colliders.collide(m_positions.data(), m_velocities.data(), m_active, parallel);
+
+    if (!respawnDue())
+        return;
+
+#pragma omp parallel for schedule(runtime) if(parallel)
+    for (auto i = 0; i < m_active; ++i)
     {
         if (m_positions[i].w < velocityThreshold)
             spawn(i);
     }
 }
 
-void Particles::processSSE41(float elapsed)
+#ifdef BUILD_WITH_AVX2
+void Particles::processCompact(const float elapsed)
 {
-    static const auto sse_gravity = _mm_load_ps(glm::value_ptr(gravity));
-    static const auto sse_friction = _mm_set_ps(0.0f, friction, friction, friction);
-    static const auto sse_one_minus_friction = _mm_set_ps(0.0f, 1.0f - friction, 1.0f - friction, 1.0f - friction);
-    static const auto sse_05 = _mm_set_ps(0.0f, 0.5f, 0.5f, 0.5f);
-    static const auto sse_1 = _mm_set_ps(0.0f, 1.0f, 1.0f, 1.0f);
-    static const auto sse_0 = _mm_set_ps(0.0f, 0.0f, 0.0f, 0.0f);
-    static const auto sse_yminus1 = _mm_set_ps(0.0f, 1.0f, -1.0f, 1.0f);
-    static const auto sse_one_minus_friction_yminus1 = _mm_mul_ps(sse_one_minus_friction, sse_yminus1);
+    const auto step = Integration(m_integrator, elapsed, friction);
+    const auto field = !m_forceField.empty();
+    const auto respawn = respawnDue();
+
+    // integration, collisions, and respawn in a single pass, unpacking each block into vec4
 
-    const auto sse_elapsed = _mm_set_ps(0.0f, elapsed, elapsed, elapsed);
-    const auto sse_elapsed2 = _mm_mul_ps(sse_elapsed, sse_elapsed);
-    const auto sse_elapsed2_5 = _mm_mul_ps(sse_05, sse_elapsed2);
+    const auto blocks = (m_active + blockSize - 1) / blockSize;
 
-#pragma omp parallel for
-    for (auto i = 0; i < static_cast<std::int32_t>(m_num); ++i)
+#pragma omp parallel for schedule(runtime)
+    for (auto i = 0; i < blocks; ++i)
     {
-        auto sse_position = _mm_load_ps(glm::value_ptr(m_positions[i]));
-        auto sse_velocity = _mm_load_ps(glm::value_ptr(m_velocities[i]));
+        const auto kernel = Kernel<WidestBatch>(step);
 
-        const auto sse_f = _mm_sub_ps(sse_gravity, _mm_mul_ps(sse_velocity, sse_friction));
+        const auto first = i * blockSize;
+        const auto count = std::min(blockSize, m_active - first);
 
-        sse_position = _mm_add_ps(sse_position, _mm_add_ps(_mm_mul_ps(sse_velocity, sse_elapsed), _mm_mul_ps(sse_f, sse_elapsed2_5)));
-        sse_velocity = _mm_add_ps(_mm_mul_ps(sse_f, sse_elapsed), sse_velocity);
+        alignas(64) glm::vec4 positions[blockSize];
+        alignas(64) glm::vec4 velocities[blockSize];
+        unpackBlock(&m_compactPositions[first], &m_compactVelocities[3 * first], count, positions, velocities);
+
+        alignas(64) glm::vec4 samples[blockSize];
+        if (field)
+        {
+            for (auto j = 0; j < blockSize; j += 8)
+                m_forceField.sample8(&positions[j], &samples[j]);
+        }
 
-        const auto sse_compare = _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(_mm_cmplt_ps(sse_position, sse_0)), _MM_SHUFFLE(1, 1, 1, 1)));
+        auto p = glm::value_ptr(positions[0]);
+        auto v = glm::value_ptr(velocities[0]);
+        for (auto j = 0; j < 4 * blockSize; j += static_cast<int>(WidestBatch::size))
+            kernel(p + j, v + j, field ? glm::value_ptr(samples[0]) + j : nullptr);
 
-        sse_position = _mm_mul_ps(sse_position, _mm_blendv_ps(sse_1, sse_yminus1, sse_compare));
-        sse_velocity = _mm_mul_ps(sse_velocity, _mm_blendv_ps(sse_1, sse_one_minus_friction_yminus1, sse_compare));
+        m_colliders.collide(positions, velocities, count, false);
 
-        sse_position = _mm_blend_ps(sse_position, _mm_dp_ps(sse_velocity, sse_velocity, 0x78), 0x8);
+        for (auto j = 0; respawn && j < count; ++j)
+        {
+            if (positions[j].w < velocityThreshold)
+                spawn(positions[j], velocities[j]);
+        }
 
-        _mm_store_ps(glm::value_ptr(m_positions[i]), sse_position);
-        _mm_store_ps(glm::value_ptr(m_velocities[i]), sse_velocity);
+        packBlock(positions, velocities, count, &m_compactPositions[first], &m_compactVelocities[3 * first]);
     }
+}
+#else
+// the compact mode is not available without AVX2 and F16C
+void Particles::processCompact(const float /*elapsed*/)
+{
+}
+#endif
 
-#pragma omp parallel for
-    for (auto i = 0; i < m_num; ++i)
+void Particles::packStorage()
+{
+#ifdef BUILD_WITH_AVX2
+    m_compactPositions.resize(m_positions.size());
+    m_compactVelocities.resize(3 * m_velocities.size());
+
+    const auto num = static_cast<int>(m_positions.size());
+    const auto blocks = (num + blockSize - 1) / blockSize;
+
+#pragma omp parallel for schedule(runtime)
+    for (auto i = 0; i < blocks; ++i)
     {
-        if (m_positions[i].w < velocityThreshold)
-            spawn(i);
+        const auto first = i * blockSize;
+        packBlock(&m_positions[first], &m_velocities[first], std::min(blockSize, num - first), &m_compactPositions[first], &m_compactVelocities[3 * first]);
     }
+
+    // swap, as clear and shrink_to_fit do not guarantee to release the memory
+    decltype(m_positions)().swap(m_positions);
+    decltype(m_velocities)().swap(m_velocities);
+#endif
 }
 
-void Particles::processAVX2(float elapsed)
+void Particles::unpackStorage()
 {
 #ifdef BUILD_WITH_AVX2
-    static const auto avx_gravity = _mm256_set_ps(gravity.w, gravity.z, gravity.y, gravity.x, gravity.w, gravity.z, gravity.y, gravity.x);
-    static const auto avx_friction = _mm256_set_ps(0.0f, friction, friction, friction, 0.0f, friction, friction, friction);
-    static const auto avx_one_minus_friction = _mm256_set_ps(0.0f, 1.0f - friction, 1.0f - friction, 1.0f - friction, 0.0f, 1.0f - friction, 1.0f - friction, 1.0f - friction);
-    static const auto avx_05 = _mm256_set_ps(0.0f, 0.5f, 0.5f, 0.5f, 0.0f, 0.5f, 0.5f, 0.5f);
-    static const auto avx_1 = _mm256_set_ps(0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f);
-    static const auto avx_0 = _mm256_set_ps(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-    static const auto avx_yminus1 = _mm256_set_ps(0.0f, 1.0f, -1.0f, 1.0f, 0.0f, 1.0f, -1.0f, 1.0f);
-    static const auto avx_one_minus_friction_yminus1 = _mm256_mul_ps(avx_one_minus_friction, avx_yminus1);
+    const auto num = static_cast<int>(m_compactPositions.size());
+    m_positions.resize(num);
+    m_velocities.resize(num);
 
-    const auto avx_elapsed = _mm256_set_ps(0.0f, elapsed, elapsed, elapsed, 0.0f, elapsed, elapsed, elapsed);
-    const auto avx_elapsed2 = _mm256_mul_ps(avx_elapsed, avx_elapsed);
-    const auto avx_elapsed2_5 = _mm256_mul_ps(avx_05, avx_elapsed2);
+    const auto blocks = (num + blockSize - 1) / blockSize;
 
-#pragma omp parallel for
-    for (auto i = 0; i < static_cast<std::int32_t>(m_num) / 2; ++i)
+#pragma omp parallel for schedule(runtime)
+    for (auto i = 0; i < blocks; ++i)
     {
-        auto avx_position = _mm256_load_ps(glm::value_ptr(m_positions[2 * i]));
-        auto avx_velocity = _mm256_load_ps(glm::value_ptr(m_velocities[2 * i]));
+        const auto first = i * blockSize;
+        const auto count = std::min(blockSize, num - first);
 
-        //const auto avx_f = _mm256_sub_ps(avx_gravity, _mm256_mul_ps(avx_velocity, avx_friction));
-        const auto avx_f = _mm256_fnmadd_ps(avx_velocity, avx_friction, avx_gravity); // FMA4
+        alignas(64) glm::vec4 positions[blockSize];
+        alignas(64) glm::vec4 velocities[blockSize];
+        unpackBlock(&m_compactPositions[first], &m_compactVelocities[3 * first], count, positions, velocities);
 
-                                                                                      //avx_position = _mm256_add_ps(avx_position, _mm256_add_ps(_mm256_mul_ps(avx_velocity, avx_elapsed), _mm256_mul_ps(avx_f, avx_elapsed2_5)));
-        avx_position = _mm256_add_ps(_mm256_mul_ps(avx_velocity, avx_elapsed), _mm256_fmadd_ps(avx_f, avx_elapsed2_5, avx_position)); // FMA4
-                                                                                                                                      //avx_velocity = _mm256_add_ps(_mm256_mul_ps(avx_f, avx_elapsed), avx_velocity);
-        avx_velocity = _mm256_fmadd_ps(avx_f, avx_elapsed, avx_velocity); // FMA4
+        for (auto j = 0; j < count; ++j)
+        {
+            m_positions[first + j] = glm::vec4(glm::vec3(positions[j]), glm::dot(glm::vec3(velocities[j]), glm::vec3(velocities[j])));
+            m_velocities[first + j] = velocities[j];
+        }
+    }
+
+    decltype(m_compactPositions)().swap(m_compactPositions);
+    decltype(m_compactVelocities)().swap(m_compactVelocities);
+#endif
+}
 
-        const auto avx_compare = _mm256_permute_ps(_mm256_cmp_ps(avx_position, avx_0, 1), _MM_SHUFFLE(1, 1, 1, 1));
+void Particles::uploadCompact()
+{
+#ifdef BUILD_WITH_AVX2
+    // expands into the mapped buffer directly, a vec4 copy would take the memory saved
 
-        avx_position = _mm256_mul_ps(avx_position, _mm256_blendv_ps(avx_1, avx_yminus1, avx_compare));
-        avx_velocity = _mm256_mul_ps(avx_velocity, _mm256_blendv_ps(avx_1, avx_one_minus_friction_yminus1, avx_compare));
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbos[0]);
 
-        avx_position = _mm256_blend_ps(avx_position, _mm256_dp_ps(avx_velocity, avx_velocity, 0x78), 0x88);
+    auto target = static_cast<glm::vec4 *>(m_bufferPointer);
+    if (!target)
+    {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_active, nullptr, GL_STREAM_DRAW);
+        target = static_cast<glm::vec4 *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * m_active,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
 
-        _mm256_store_ps(glm::value_ptr(m_positions[2 * i]), avx_position);
-        _mm256_store_ps(glm::value_ptr(m_velocities[2 * i]), avx_velocity);
+        if (!target)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            return;
+        }
     }
 
-#pragma omp parallel for
-    for (auto i = 0; i < m_num; ++i)
+    const auto blocks = (m_active + blockSize - 1) / blockSize;
+
+#pragma omp parallel for schedule(runtime)
+    for (auto i = 0; i < blocks; ++i)
     {
-        if (m_positions[i].w < velocityThreshold)
-            spawn(i);
+        const auto first = i * blockSize;
+        const auto count = std::min(blockSize, m_active - first);
+
+        alignas(64) glm::vec4 positions[blockSize];
+        alignas(64) glm::vec4 velocities[blockSize];
+        unpackBlock(&m_compactPositions[first], &m_compactVelocities[3 * first], count, positions, velocities);
+
+        // squared speed in w, as in the other processing modes
+        for (auto j = 0; j < count; ++j)
+            target[first + j] = glm::vec4(glm::vec3(positions[j]), glm::dot(glm::vec3(velocities[j]), glm::vec3(velocities[j])));
     }
+
+    if (m_bufferPointer)
+        glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * m_active);
+    else
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 #endif
 }
 
 void Particles::processComputeShaders(float elapsed)
 {
-    static const int max_invocations = getComputeMaxInvocations();
-    static const glm::ivec3 max_count = getMaxComputeWorkGroupCounts();
-
-    const auto elapsed2 = elapsed * elapsed;
-
-    const auto groups = static_cast<int>(ceil(static_cast<float>(m_num) / static_cast<float>(64)));
+    if (m_emitRate > 0.f)
+    {
+        processEmitter(elapsed);
+        return;
+    }
 
-    const auto workGroupSize = glm::ivec3(groups, 1, 1);
+    const auto step = Integration(m_integrator, elapsed, friction);
 
     glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, m_vbos[0]);
     glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 1, m_vbos[1]);
 
     glUseProgram(m_programs[3]);
 
-    glUniform1f(0, elapsed);
-    glUniform1f(1, elapsed2);
-    glUniform1f(2, m_elapsedSinceEpoch);
-    //glUniform1f(3, friction);
-    //glUniform4fv(4, 1, glm::value_ptr(gravity));
-    //glUniform1f(5, velocityThreshold);
-    gl32ext::glDispatchCompute(workGroupSize.x, workGroupSize.y, workGroupSize.z);
+    glUniform1f(m_uniformLocations[45], elapsed);
+    glUniform4f(m_uniformLocations[46], step.drift, step.push, step.decay, step.kick);
+    glUniform1f(m_uniformLocations[47], m_elapsedSinceEpoch);
+    glUniform1i(m_uniformLocations[48], m_active);
+
+    const auto field = !m_forceField.empty();
+    if (field)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_3D, m_fieldTexture);
+        glUniform3fv(m_uniformLocations[62], 1, glm::value_ptr(m_forceField.origin()));
+        glUniform1f(m_uniformLocations[63], 1.f / m_forceField.spacing());
+        glUniform3fv(m_uniformLocations[64], 1, glm::value_ptr(glm::vec3(m_forceField.resolution() - 1)));
+        glUniform1f(m_uniformLocations[65], m_forceField.strength());
+    }
+    gl32ext::glDispatchCompute(updateGroups(), 1, 1);
     glUseProgram(0);
 
+    if (field)
+        glBindTexture(GL_TEXTURE_3D, 0);
+
     //glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
     glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, 0);
     glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 1, 0);
 }
 
+void Particles::processEmitter(float elapsed)
+{
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, m_vbos[0]);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 1, m_vbos[1]);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 5, m_emitterBuffer);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 6, m_deadBuffer);
+
+    // update, appending expired particles to the dead list
+
+    glUseProgram(m_programs[14]);
+
+    glUniform1f(m_uniformLocations[39], elapsed);
+    const auto step = Integration(m_integrator, elapsed, friction);
+    glUniform4f(m_uniformLocations[40], step.drift, step.push, step.decay, step.kick);
+    glUniform1i(m_uniformLocations[41], m_active);
+
+    const auto field = !m_forceField.empty();
+    if (field)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_3D, m_fieldTexture);
+        glUniform3fv(m_uniformLocations[66], 1, glm::value_ptr(m_forceField.origin()));
+        glUniform1f(m_uniformLocations[67], 1.f / m_forceField.spacing());
+        glUniform3fv(m_uniformLocations[68], 1, glm::value_ptr(glm::vec3(m_forceField.resolution() - 1)));
+        glUniform1f(m_uniformLocations[69], m_forceField.strength());
+    }
+
+    gl32ext::glDispatchCompute(updateGroups(), 1, 1);
+    gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if (field)
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+    // clamp the budget to the dead particles and set up the emission dispatch on the GPU
+
+    m_emitBudget += m_emitRate * elapsed;
+    const auto budget = static_cast<std::uint32_t>(m_emitBudget);
+    m_emitBudget -= static_cast<float>(budget);
+
+    glUseProgram(m_programs[15]);
+    glUniform1ui(m_uniformLocations[42], budget);
+
+    gl32ext::glDispatchCompute(1, 1, 1);
+    gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT | gl::GL_COMMAND_BARRIER_BIT);
+
+    // emit
+
+    glUseProgram(m_programs[16]);
+    glUniform1f(m_uniformLocations[43], m_elapsedSinceEpoch);
+    glUniform1f(m_uniformLocations[44], m_emitLifetime);
+
+    glBindBuffer(gl::GL_DISPATCH_INDIRECT_BUFFER, m_emitterBuffer);
+    gl32ext::glDispatchComputeIndirect(2 * sizeof(std::uint32_t));
+    glBindBuffer(gl::GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT | gl::GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    glUseProgram(0);
+
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 5, 0);
+    glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 6, 0);
+}
+
+int Particles::updateGroups() const
+{
+    const auto perGroup = static_cast<std::int64_t>(m_groupSize) * m_particlesPerThread;
+    const auto groups = (static_cast<std::int64_t>(m_active) + perGroup - 1) / perGroup;
+
+    // the grid-stride loop covers the remainder if the group count is exceeded
+    return static_cast<int>(std::min<std::int64_t>(groups, m_maxGroupCount));
+}
+
 void Particles::render()
 {
     // measurement
@@ -764,6 +2351,11 @@ void Particles::render()
 
         std::cout << static_cast<float>(measureTargetCount) / time << " frames per second (" << time << "ms per frame)" << std::endl;
         m_measure = false;
+
+        auto result = cgutils::BenchmarkResult();
+        reportCounters(result);
+        for (const auto & metric : result.metrics())
+            std::cout << "  " << metric.first << ": " << metric.second << std::endl;
     }
 
     // render
@@ -775,61 +2367,232 @@ void Particles::render()
     const auto center = glm::vec3(0.f, 0.5f, 0.f);
 
     const auto view = glm::lookAt(eye, center, glm::vec3(0.f, 1.f, 0.f));
-    const auto projection = glm::perspective(glm::radians(30.f), static_cast<float>(m_width) / m_height, 0.1f, 8.f);
+    const auto projection = glm::perspective(glm::radians(30.f), static_cast<float>(m_width) / m_height, depthRange.x, depthRange.y);
+
+
+    // read the timer query of the previous frame, if ready, to not stall the pipeline
+
+    const auto current = m_drawFrame % m_drawQueries.size();
+    const auto previous = (m_drawFrame + 1) % m_drawQueries.size();
+    ++m_drawFrame;
+
+    if (m_drawQueryIssued[previous] && readTimerQuery(m_drawQueries[previous], m_drawTime))
+    {
+        m_drawQueryIssued[previous] = false;
+
+        if (m_drawMode == DrawingMode::Fluid)
+            updateFluidScale();
+    }
+
+    if (m_sortQueryIssued[previous] && readTimerQuery(m_sortQueries[previous], m_sortTime))
+        m_sortQueryIssued[previous] = false;
+
+    auto drawMode = m_drawMode;
+    if (drawMode == DrawingMode::Splats && !m_computeShadersAvailable)
+        drawMode = DrawingMode::BuiltInPoints;
+    // the sorted order is pulled via a buffer texture
+    if (drawMode == DrawingMode::Translucent && (!m_computeShadersAvailable || m_active > m_maxBufferTexels))
+        drawMode = DrawingMode::CustomQuads;
 
+    // sort before and timed separately from drawing, as timer queries cannot be nested
 
-    switch (m_drawMode)
+    if (drawMode == DrawingMode::Translucent)
+    {
+        const auto timingSort = !m_sortQueryIssued[current];
+        if (timingSort)
+            glBeginQuery(gl::GL_TIME_ELAPSED, m_sortQueries[current]);
+
+        sort(projection * view);
+
+        if (timingSort)
+        {
+            glEndQuery(gl::GL_TIME_ELAPSED);
+            m_sortQueryIssued[current] = true;
+        }
+    }
+    else
+        m_sortTime = 0.f;
+
+    const auto timing = !m_drawQueryIssued[current];
+    if (timing)
+        glBeginQuery(gl::GL_TIME_ELAPSED, m_drawQueries[current]);
+
+    switch (drawMode)
     {
     case Particles::DrawingMode::None:
         break;
+
+    case Particles::DrawingMode::Splats:
+        {
+            static const auto cleared = std::numeric_limits<std::uint32_t>::max(); // maximum depth in the upper 32 bits
+
+            glBindBuffer(gl::GL_SHADER_STORAGE_BUFFER, m_splatBuffer);
+            gl32ext::glClearBufferData(gl::GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &cleared);
+            glBindBuffer(gl::GL_SHADER_STORAGE_BUFFER, 0);
+
+            glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, m_vbos[0]);
+            glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 2, m_splatBuffer);
+
+            // splat, with a second dimension of work groups beyond the guaranteed count
+
+            const auto groups = (m_active + splatGroupSize - 1) / splatGroupSize;
+            const auto groupsX = glm::min(groups, maximumGroupCount);
+            const auto groupsY = groupsX > 0 ? (groups + groupsX - 1) / groupsX : 0;
+
+            glUseProgram(m_programs[11]);
+
+            glUniformMatrix4fv(m_uniformLocations[30], 1, GL_FALSE, glm::value_ptr(projection * view));
+            glUniform2i(m_uniformLocations[31], m_width, m_height);
+            glUniform1i(m_uniformLocations[32], m_active);
+
+            gl32ext::glDispatchCompute(groupsX, groupsY, 1);
+            gl32ext::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT);
+
+            // resolve
+
+            glUseProgram(m_programs[12]);
+            glUniform2i(m_uniformLocations[33], m_width, m_height);
+
+            glBindVertexArray(m_vaos[1]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+
+            glUseProgram(0);
+
+            glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, 0);
+            glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 2, 0);
+        }
+        break;
+    case Particles::DrawingMode::Translucent:
+        {
+            // back to front from the sorted indices, blended without depth writes (not culled)
+
+            glUseProgram(m_programs[21]);
+
+            glUniformMatrix4fv(m_uniformLocations[59], 1, GL_FALSE, glm::value_ptr(projection * view));
+            glUniform3f(m_uniformLocations[60], 1.f / m_width, 1.f / m_height, m_radius);
+            glUniform1i(m_uniformLocations[61], 1);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, m_positionTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_vbos[0]);
+
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_BUFFER, m_orderTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_sortValues[sortPasses % 2]);
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+
+            glBindVertexArray(m_vaos[2]);
+            glDrawArrays(GL_TRIANGLES, 0, m_active * 6);
+            glBindVertexArray(0);
+
+            glDepthMask(GL_TRUE);
+            glDisable(GL_BLEND);
+
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+            glUseProgram(0);
+        }
+        break;
     case Particles::DrawingMode::Fluid:
         {
+            // depth pass at fluid resolution
+
+            glViewport(0, 0, m_fluidWidth, m_fluidHeight);
+
             glBindFramebuffer(GL_FRAMEBUFFER, m_fbo[0]);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            glUseProgram(m_programs[4]);
+            const auto pulling = vertexPullingActive();
+            const auto offset = pulling ? 24 : 6;
+
+            if (m_gpuCulling && m_computeShadersAvailable)
+                cull(projection * view, glm::vec2(m_radius * 0.0007f * projection[1][1] * m_height * 0.5f, 0.f), pulling);
 
-            glUniformMatrix4fv(m_uniformLocations[6], 1, GL_FALSE, glm::value_ptr(view));
-            glUniformMatrix4fv(m_uniformLocations[7], 1, GL_FALSE, glm::value_ptr(projection));
+            glUseProgram(m_programs[pulling ? 10 : 4]);
+
+            glUniformMatrix4fv(m_uniformLocations[offset + 0], 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(m_uniformLocations[offset + 1], 1, GL_FALSE, glm::value_ptr(projection));
             const auto ndcInverse = glm::inverse(projection * view);
-            glUniformMatrix4fv(m_uniformLocations[8], 1, GL_FALSE, glm::value_ptr(ndcInverse));
+            glUniformMatrix4fv(m_uniformLocations[offset + 2], 1, GL_FALSE, glm::value_ptr(ndcInverse));
             const auto normal = glm::mat3(glm::inverse(view));
-            glUniformMatrix3fv(m_uniformLocations[10], 1, GL_FALSE, glm::value_ptr(normal));
+            glUniformMatrix3fv(m_uniformLocations[offset + 4], 1, GL_FALSE, glm::value_ptr(normal));
             const auto eye2 = glm::normalize(center - eye);
-            glUniform3fv(m_uniformLocations[11], 1, glm::value_ptr(eye2));
-            glUniform4f(m_uniformLocations[9], 1.f / m_width, 1.f / m_height, m_radius * 0.0007f, static_cast<float>(m_width) / m_height);
+            glUniform3fv(m_uniformLocations[offset + 5], 1, glm::value_ptr(eye2));
+            glUniform4f(m_uniformLocations[offset + 3], 1.f / m_width, 1.f / m_height, m_radius * 0.0007f, static_cast<float>(m_width) / m_height);
 
-            glBindVertexArray(m_vaos[0]);
-            glDrawArrays(GL_POINTS, 0, m_num);
-            glBindVertexArray(0);
+            drawParticles(pulling);
 
 
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
             glBindVertexArray(m_vaos[1]);
 
             glActiveTexture(GL_TEXTURE0);
-            glUseProgram(m_programs[5]);
 
+            // separable smoothing at fluid resolution: horizontal into textures[1], vertical into textures[2]
+
+            if (m_fluidCompute && m_computeShadersAvailable)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+                glUseProgram(m_programs[7]);
+                glUniform1i(m_uniformLocations[17], 0);
+                glUniform1i(m_uniformLocations[19], m_fluidRadius);
+
+                for (auto pass = 0; pass < 2; ++pass)
+                {
+                    const auto horizontal = pass == 0;
+                    const auto extent = horizontal ? m_fluidWidth : m_fluidHeight;
+
+                    glBindTexture(GL_TEXTURE_2D, m_textures[pass]);
+                    gl32ext::glBindImageTexture(0, m_textures[pass + 1], 0, GL_FALSE, 0, gl::GL_WRITE_ONLY, gl::GL_R32F);
+
+                    glUniform2i(m_uniformLocations[18], horizontal ? 1 : 0, horizontal ? 0 : 1);
+
+                    gl32ext::glDispatchCompute((extent + fluidGroupSize - 1) / fluidGroupSize, horizontal ? m_fluidHeight : m_fluidWidth, 1);
+                    gl32ext::glMemoryBarrier(gl::GL_TEXTURE_FETCH_BARRIER_BIT);
+                }
 
-            glUniformMatrix4fv(m_uniformLocations[14], 1, GL_FALSE, glm::value_ptr(ndcInverse));
+                gl32ext::glBindImageTexture(0, 0, 0, GL_FALSE, 0, gl::GL_WRITE_ONLY, gl::GL_R32F);
+            }
+            else
+            {
+                glUseProgram(m_programs[5]);
+                glUniform1i(m_uniformLocations[12], 0);
+                glUniform1i(m_uniformLocations[16], m_fluidRadius);
 
-            //glBindFramebuffer(GL_FRAMEBUFFER, m_fbo[1]);
-            //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                for (auto pass = 0; pass < 2; ++pass)
+                {
+                    const auto horizontal = pass == 0;
 
-            //glBindTexture(GL_TEXTURE_2D, m_textures[0]);
+                    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo[pass + 1]);
+                    glClear(GL_COLOR_BUFFER_BIT);
 
-            //glUniform1i(m_uniformLocations[12], 0);
-            //glUniform2f(m_uniformLocations[13], 1.f, 0.f);
+                    glBindTexture(GL_TEXTURE_2D, m_textures[pass]);
 
-            //glDrawArrays(GL_TRIANGLES, 0, 3);
+                    glUniform2f(m_uniformLocations[13], horizontal ? 1.f : 0.f, horizontal ? 0.f : 1.f);
 
+                    glDrawArrays(GL_TRIANGLES, 0, 3);
+                }
+            }
+
+            // edge-aware upsampling and reconstruction at window resolution
+
+            glViewport(0, 0, m_width, m_height);
 
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-            glBindTexture(GL_TEXTURE_2D, m_textures[0]);
+            glUseProgram(m_programs[6]);
 
-            glUniform1i(m_uniformLocations[12], 0);
-            glUniform2f(m_uniformLocations[13], 0.f, 1.f);
+            glBindTexture(GL_TEXTURE_2D, m_textures[2]);
+
+            glUniform1i(m_uniformLocations[14], 0);
+            glUniformMatrix4fv(m_uniformLocations[15], 1, GL_FALSE, glm::value_ptr(ndcInverse));
 
             glDrawArrays(GL_TRIANGLES, 0, 3);
 
@@ -846,8 +2609,16 @@ void Particles::render()
 
     default:
         {
-            const auto programIndex = static_cast<size_t>(m_drawMode) - 1;
-            const auto uniformLocationOffset = programIndex * 2;
+            // built-in points are never pulled, the quad modes map to programs 8 and 9
+            const auto pulling = drawMode != DrawingMode::BuiltInPoints && vertexPullingActive();
+
+            const auto programIndex = static_cast<size_t>(drawMode) - 1 + (pulling ? 7 : 0);
+            const auto uniformLocationOffset = pulling ? 20 + (programIndex - 8) * 2 : programIndex * 2;
+
+            // points have a constant size in pixels, quads a constant size in clip space
+            if (m_gpuCulling && m_computeShadersAvailable)
+                cull(projection * view, drawMode == DrawingMode::BuiltInPoints
+                    ? glm::vec2(0.f, m_radius * 0.25f * glm::sqrt(glm::pi<float>())) : glm::vec2(m_radius * 0.5f, 0.f), pulling);
 
             glUseProgram(m_programs[programIndex]);
 
@@ -864,71 +2635,82 @@ void Particles::render()
             glUniformMatrix4fv(m_uniformLocations[uniformLocationOffset + 0], 1, GL_FALSE, glm::value_ptr(transform));
             glUniform3f(m_uniformLocations[uniformLocationOffset + 1], 1.f / m_width, 1.f / m_height, m_radius);
 
-            glBindVertexArray(m_vaos[0]);
-
-            if (m_drawMode == DrawingMode::BuiltInPoints)
+            if (drawMode == DrawingMode::BuiltInPoints)
                 glPointSize(m_radius * 0.5f * glm::sqrt(glm::pi<float>()));
 
-            glDrawArrays(GL_POINTS, 0, m_num);
-
-            glBindVertexArray(0);
+            drawParticles(pulling);
 
             glUseProgram(0);
         }
         break;
     }
 
+    if (timing)
+    {
+        glEndQuery(gl::GL_TIME_ELAPSED);
+        m_drawQueryIssued[current] = true;
+    }
+
     if (m_paused)
         return;
 
     const auto e = elapsed();
 
-    auto maxElapsed = 0.016f;
-    const auto numIterations = m_measure ? 1 : glm::max(1, glm::min(8, static_cast<int>(e / maxElapsed)));
+    if (m_governor.update(e * 1000.f))
+    {
+        applyQuality();
+
+        const auto & settings = m_governor.settings();
+        std::cout << "Quality level " << m_governor.level() << ": " << m_active << " particles, "
+            << settings.maxSubsteps << " substeps at most, respawn every " << settings.respawnStride << " steps" << std::endl;
+    }
+
+    const auto maxElapsed = m_maxStep;
+    const auto maxSubsteps = m_governor.settings().maxSubsteps;
+    const auto numIterations = m_measure ? 1 : glm::max(1, glm::min(maxSubsteps, static_cast<int>(e / maxElapsed)));
 
     const auto e2 = e / numIterations;
 
+    m_counters.start();
+    const auto processTime0 = std::chrono::high_resolution_clock::now();
+
     for (auto i = 0; i < numIterations; ++i)
     {
-        switch (m_processingMode)
-        {
-        case Particles::ProcessingMode::CPU:
-            process(e2);
-            break;
-        case Particles::ProcessingMode::CPU_OMP:
-            processOMP(e2);
-            break;
-        case Particles::ProcessingMode::CPU_OMP_SSE41:
-            processSSE41(e2);
-            break;
-        case Particles::ProcessingMode::CPU_OMP_AVX2:
-            processAVX2(e2);
-            break;
-        case Particles::ProcessingMode::GPU_ComputeShaders:
+        if (m_processingMode == ProcessingMode::GPU_ComputeShaders)
             processComputeShaders(e2);
-            break;
-
-        default:
-            break;
-        }
+        else if (m_processingMode == ProcessingMode::CPU_OMP_Compact)
+            processCompact(e2);
+        else if (available(m_processingMode))
+            processCPU(m_processingMode, e2);
     }
 
+    // for GPU processing, this covers the dispatch only
+    m_countedTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - processTime0).count();
+    m_countedParticles += static_cast<std::uint64_t>(m_active) * numIterations;
+    m_counters.stop();
+
     if (m_processingMode == ProcessingMode::GPU_ComputeShaders)
         return;
 
+    if (m_processingMode == ProcessingMode::CPU_OMP_Compact)
+    {
+        uploadCompact();
+        return;
+    }
+
     if (m_bufferStorageAvailable)
     {
         assert(nullptr != m_bufferPointer);
 
-        std::memcpy(m_bufferPointer, m_positions.data(), sizeof(glm::vec4) * m_num);
+        std::memcpy(m_bufferPointer, m_positions.data(), sizeof(glm::vec4) * m_active);
         glBindBuffer(GL_ARRAY_BUFFER, m_vbos[0]);
-        glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * m_num);
+        glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * m_active);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
     else
     {
         glBindBuffer(GL_ARRAY_BUFFER, m_vbos[0]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_num, m_positions.data(), GL_STREAM_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_active, m_positions.data(), GL_STREAM_DRAW);
         //glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * m_num, m_positions.data()); // sub data is slower
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
@@ -1,11 +1,20 @@
+#pragma once
 
 #include <glbinding/gl32core/gl.h>  // this is a OpenGL feature include; it declares all OpenGL 3.2 Core symbols
 
 #include <chrono>
 #include <array>
+#include <string>
 #include <vector>
 
+#include <cgutils/perfcounters.h>
+
 #include "allocator.h"
+#include "barneshut.h"
+#include "colliders.h"
+#include "forcefield.h"
+#include "governor.h"
+#include "integration.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4201)
@@ -13,13 +22,21 @@
 #include <glm/mat4x4.hpp>
 #pragma warning(pop)
 
-#ifdef BUILD_WITH_AVX2
+#if defined(BUILD_WITH_AVX512)
+#define SIMD_COUNT 4
+#elif defined(BUILD_WITH_AVX2)
 #define SIMD_COUNT 2
 #else
 #define SIMD_COUNT 1
 #endif
 
 
+namespace cgutils
+{
+    class BenchmarkResult;
+}
+
+
 // For more information on how to write C++ please adhere to: 
 // http://cginternals.github.io/guidelines/cpp/index.html
 
@@ -32,7 +49,10 @@ public:
         CPU_OMP,
         CPU_OMP_SSE41,
         CPU_OMP_AVX2,
-        GPU_ComputeShaders
+        GPU_ComputeShaders,
+        CPU_OMP_BarnesHut, // mutual attraction of the particles in addition to gravity
+        CPU_OMP_AVX512,
+        CPU_OMP_Compact // float positions and half float velocities without padding, requires F16C (AVX2 builds)
     };
 
     enum class DrawingMode
@@ -41,7 +61,9 @@ public:
         BuiltInPoints,
         CustomQuads,
         ShadedQuads,
-        Fluid
+        Fluid,
+        Splats, // single pixel splats by compute shader, built-in points if unavailable
+        Translucent // blended quads sorted back to front on the GPU, custom quads if unavailable
     };
 
 public:
@@ -59,8 +81,105 @@ public:
 
     void pause();
 
-    void setProcessing(const ProcessingMode mode);
+    // Returns false and keeps the current mode if the given one is not available.
+    bool setProcessing(const ProcessingMode mode);
     void setDrawing(const DrawingMode mode);
+
+    ProcessingMode processing() const;
+    DrawingMode drawing() const;
+
+    bool available(ProcessingMode mode) const;
+
+    // OpenMP threads (0 for one per logical cpu) and static schedule chunk size in loop
+    // iterations (0 for equally sized chunks, one per thread) of the CPU processing modes.
+    int threads() const;
+    void setThreads(int threads);
+    int chunkSize() const;
+    void setChunkSize(int chunkSize);
+
+    // Work group size (clamped to the implementation's limit) and particles per invocation
+    // of the compute shader processing. The update kernel is specialized to the group size
+    // and processes particles in a grid-stride loop, dispatching at most the maximum work
+    // group count, so counts beyond a single dispatch of one particle per invocation work.
+    int computeGroupSize() const;
+    int computeParticlesPerThread() const;
+    int maxComputeGroupSize() const;
+    void setComputeConfiguration(int groupSize, int particlesPerThread);
+
+    // Opening angle of the Barnes-Hut approximation (0 for exact pairwise forces) and its
+    // gravitational constant times the total mass of the particles, see BarnesHut.
+    float openingAngle() const;
+    void setOpeningAngle(float theta);
+    float attraction() const;
+    void setAttraction(float strength);
+
+    // Solids the particles bounce off in the CPU processing modes, in addition to the ground.
+    Colliders & colliders();
+    bool loadColliders(const std::string & filePath); // see Colliders::load
+
+    // Spatially varying acceleration, e.g., wind or turbulence, in all processing modes; the
+    // compute shaders sample a half float copy in a 3D texture. See ForceField.
+    const ForceField & forceField() const;
+    bool loadForceField(const std::string & rawFile, const glm::ivec3 & resolution, const glm::vec3 & origin, float spacing);
+    void generateForceField(const glm::ivec3 & resolution, const glm::vec3 & origin, float spacing, float frequency);
+    void setForceFieldStrength(float strength);
+    void clearForceField();
+
+    // Integration scheme of all processing modes, see Integration, and the longest step a
+    // frame is split into (up to the governor's substeps); stable schemes allow longer steps.
+    Integration::Scheme integrator() const;
+    void setIntegrator(Integration::Scheme scheme);
+    float maxStep() const;
+    void setMaxStep(float seconds);
+
+    // Runs a single processing step in the given mode (switching to it if required) and
+    // waits for its completion, e.g., to benchmark the kernels independent of drawing.
+    void step(ProcessingMode mode, float elapsed);
+
+    // Largest absolute difference of positions and velocities after an integration step in
+    // the given CPU processing mode to the scalar reference kernel, starting from and keeping
+    // the current state; excludes collisions and respawn. Negative for the compute shaders
+    // and the compact storage, whose half float velocities deviate by design.
+    float deviation(ProcessingMode mode, float elapsed);
+
+    // Nominal memory traffic and floating point operations of a processing step per particle.
+    static std::size_t bytesPerParticle(ProcessingMode mode);
+    static std::size_t flopsPerParticle();
+
+    // Memory held per particle by the current processing mode, on the CPU and in the GL buffers.
+    std::size_t residentBytesPerParticle() const;
+
+    std::int32_t numParticles() const;
+    void setNumParticles(std::int32_t num);
+    // Particles that are currently simulated and drawn, lowered by the governor if enabled.
+    std::int32_t numActiveParticles() const;
+
+    // Replaces the in-place respawn of the compute shader processing by an emitter: particles
+    // that expire after lifetime seconds or come to rest are appended to a dead list on the
+    // GPU, from which a separate kernel respawns rate particles per second (0 disables).
+    float emitRate() const;
+    float emitLifetime() const;
+    void setEmitter(float rate, float lifetime);
+
+    // Frame budget in milliseconds the simulation load is adapted to (0 disables).
+    void setFrameBudget(float milliseconds);
+    const Governor & governor() const;
+
+    // The fluid depth and smoothing passes run at a fraction of the window resolution and
+    // are upsampled edge-aware. Setting a scale fixes it; with a budget in milliseconds of
+    // GPU time for the fluid passes (0 disables) the scale is adapted to meet it instead.
+    float fluidScale() const;
+    void setFluidScale(float scale);
+    void setFluidBudget(float milliseconds);
+    // GPU time of the fluid passes in milliseconds, as measured a few frames ago.
+    float fluidTime() const;
+    // Radius in fluid resolution texels (up to 32) of the separable, bilateral depth
+    // smoothing, run either as two fragment passes or, if available, as two compute
+    // passes with shared memory tiles.
+    int fluidRadius() const;
+    void setFluidRadius(int radius);
+    bool fluidCompute() const;
+    void setFluidCompute(bool compute);
     
     float scale();
     void setScale(float scale);
@@ -68,23 +187,77 @@ public:
     float angle() const;
     void rotate(float angle);
 
+    // Expands the quads of the quad and fluid drawing modes in the vertex shader, pulling
+    // positions from a buffer texture, instead of in a geometry shader. Falls back to the
+    // geometry shader for more particles than GL_MAX_TEXTURE_BUFFER_SIZE.
+    bool vertexPulling() const;
+    void setVertexPulling(bool enable);
+    bool vertexPullingActive() const; // enabled and not fallen back
+
+    // GPU time of drawing in milliseconds, as measured a few frames ago.
+    float drawTime() const;
+    // GPU time of the depth sort of the translucent drawing mode in milliseconds, measured
+    // separately from and not included in the draw time.
+    float sortTime() const;
+
+    // Culls particles outside the view frustum or with a screen radius below the given
+    // pixels in a compute pass before drawing (requires compute shaders). Visible particles
+    // are compacted into a buffer and drawn indirectly, without reading back their count.
+    bool gpuCulling() const;
+    void setGpuCulling(bool enable);
+    float cullRadius() const;
+    void setCullRadius(float pixels);
+
+    // Opens hardware performance counters for the particle processing; call before
+    // the first frame, i.e., before the OpenMP thread pool is started.
+    bool enableCounters();
+    void resetCounters();
+    // Adds processing time and, if available, counter metrics per processed particle.
+    void reportCounters(cgutils::BenchmarkResult & result) const;
+
+    static std::string toString(ProcessingMode mode);
+    static std::string toString(DrawingMode mode);
+    static bool fromString(const std::string & name, ProcessingMode & mode);
+    static bool fromString(const std::string & name, DrawingMode & mode);
+
 protected:
-    bool loadShader(gl::GLuint & shader, const std::string & sourceFile) const;
+    bool loadShader(gl::GLuint & shader, const std::string & sourceFile, const std::vector<std::string> & defines = {}) const;
     void loadUniformLocations();
     void setupTextures();
     void setupShaders();
     void resizeTextures();
+    void updateFluidScale();
+    void updateForceField(); // uploads the field and respecializes the update kernels
+    void uploadForceField();
+
+    // Screen radius of a particle in pixels is extent.x / w + extent.y, with w in clip space.
+    void cull(const glm::mat4 & transform, const glm::vec2 & extent, bool pulling);
+    void drawParticles(bool pulling);
+    // Sorts the indices of the active particles by view depth, back to front, into m_sortValues.
+    void sort(const glm::mat4 & transform);
 
     void prepare();
+    void upload();
+    void resetEmitter();
     void spawn(std::uint32_t index);
+    void spawn(glm::vec4 & position, glm::vec4 & velocity) const;
+    void applyQuality();
+    bool respawnDue();
 
     float elapsed();
 
-    void process(float elapsed);
-    void processOMP(float elapsed);
-    void processSSE41(float elapsed);
-    void processAVX2(float elapsed);
+    void processCPU(ProcessingMode mode, float elapsed);
+    void integrate(ProcessingMode mode, float elapsed);
+    template <typename Batch>
+    void integrate(float elapsed, const glm::vec4 * accelerations, bool parallel);
+    void finish(bool parallel); // collisions and respawn
+    void processCompact(float elapsed);
+    void packStorage();   // converts into the compact storage, releasing the vec4 storage
+    void unpackStorage(); // and vice versa
+    void uploadCompact();
     void processComputeShaders(float elapsed);
+    void processEmitter(float elapsed);
+    int updateGroups() const; // work groups of the update kernel for the active particles
     
     void setupBuffer(bool mapBuffer, bool bufferStorageAvailable);
 
@@ -92,34 +265,103 @@ protected:
 protected:
     std::array<gl::GLuint, 3> m_vbos;
 
-    std::array<gl::GLuint, 6> m_programs;
-    std::array<gl::GLuint, 3> m_vertexShaders;
+    std::array<gl::GLuint, 22> m_programs;
+    std::array<gl::GLuint, 6> m_vertexShaders;
     std::array<gl::GLuint, 2> m_geometryShaders;
-    std::array<gl::GLuint, 5> m_fragmentShaders;
-    std::array<gl::GLuint, 1> m_computeShaders;
+    std::array<gl::GLuint, 8> m_fragmentShaders;
+    std::array<gl::GLuint, 11> m_computeShaders;
 
-    std::array<gl::GLuint, 2> m_fbo;
-    std::array<gl::GLuint, 2> m_textures;
+    std::array<gl::GLuint, 3> m_fbo;
+    std::array<gl::GLuint, 3> m_textures;
     //std::array<gl::GLuint, 2> m_renderBuffers;
 
-    std::array<gl::GLuint, 2> m_vaos;
-
-    std::array<gl::GLuint, 15> m_uniformLocations;
+    std::array<gl::GLuint, 4> m_vaos;
+
+    gl::GLuint m_positionTexture; // buffer texture over m_vbos[0] for vertex pulling
+    gl::GLint m_maxBufferTexels;
+    bool m_vertexPulling;
+
+    gl::GLuint m_splatBuffer; // depth (and color) per pixel of the splats drawing mode
+
+    bool m_gpuCulling;
+    float m_cullRadius;
+    gl::GLuint m_visibleBuffer;  // compacted positions of the visible particles, drawn by m_vaos[3]
+    gl::GLuint m_commandBuffer;  // indirect draw command, its count written by the cull pass
+    std::int32_t m_visibleCapacity;
+
+    float m_emitRate;
+    float m_emitLifetime;
+    float m_emitBudget;         // particles due for emission, carried over to the next step
+    gl::GLuint m_emitterBuffer; // dead count, emit count, and indirect dispatch of the emission
+    gl::GLuint m_deadBuffer;    // indices of dead particles
+
+    std::array<gl::GLuint, 2> m_sortKeys;   // ping-pong buffers of the radix sort passes
+    std::array<gl::GLuint, 2> m_sortValues;
+    gl::GLuint m_sortHistogram;             // digit counts, then offsets, per tile
+    gl::GLuint m_orderTexture;              // buffer texture over the sorted indices
+    std::int32_t m_sortCapacity;
+
+    gl::GLuint m_fieldTexture; // 3D texture of the force field
+
+    std::array<gl::GLuint, 2> m_drawQueries; // ring of timer queries, read one frame later
+    std::array<bool, 2> m_drawQueryIssued;
+    std::array<gl::GLuint, 2> m_sortQueries;
+    std::array<bool, 2> m_sortQueryIssued;
+    size_t m_drawFrame;
+    float m_drawTime;
+    float m_sortTime;
+
+    float m_fluidScale;
+    float m_fluidBudget;
+    int m_fluidFramesSinceChange;
+    int m_fluidWidth;
+    int m_fluidHeight;
+    int m_fluidRadius;
+    bool m_fluidCompute;
+
+    int m_groupSize;
+    int m_particlesPerThread;
+    int m_maxGroupSize;  // of the update kernel, limited by the work group invocations and size
+    int m_maxGroupCount;
+
+    std::array<gl::GLuint, 70> m_uniformLocations;
 
     std::vector<glm::vec4, aligned_allocator<glm::vec4, SIMD_COUNT * sizeof(glm::vec4)>> m_positions;
     std::vector<glm::vec4, aligned_allocator<glm::vec4, SIMD_COUNT * sizeof(glm::vec4)>> m_velocities;
+    std::vector<glm::vec4, aligned_allocator<glm::vec4, SIMD_COUNT * sizeof(glm::vec4)>> m_accelerations; // of the n-body processing
+
+    // storage of the compact processing instead of positions and velocities, 18 bytes per particle
+    std::vector<glm::vec3> m_compactPositions;
+    std::vector<std::uint16_t> m_compactVelocities; // three half floats per particle
+
+    BarnesHut m_barnesHut;
+    Colliders m_colliders;
+    ForceField m_forceField;
 
 
     ProcessingMode m_processingMode;
     DrawingMode m_drawMode;
 
     std::int32_t m_num;
+    std::int32_t m_active;
+
+    Governor m_governor;
+    Integration::Scheme m_integrator;
+    float m_maxStep;
+    std::uint64_t m_steps; // processing steps, for the respawn stride
     float m_radius;
 
     bool m_measure;
     size_t m_measureCount;
     std::chrono::high_resolution_clock::time_point m_measureTime0;
 
+    int m_threads;
+    int m_chunkSize;
+
+    cgutils::PerfCounters m_counters;
+    std::uint64_t m_countedParticles; // particles processed since resetCounters
+    std::uint64_t m_countedTime;      // processing wall time since resetCounters in ns
+
     bool m_paused;
     float m_angle;
 
@@ -136,4 +378,6 @@ protected:
     void * m_bufferPointer;
 
     bool m_computeShadersAvailable;
+    bool m_int64AtomicsAvailable;
+    bool m_initialized;
 };
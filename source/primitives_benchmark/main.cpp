@@ -0,0 +1,211 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cgutils/arguments.h>
+#include <cgutils/parallel.h>
+
+
+// From http://en.cppreference.com/w/cpp/language/namespace:
+// "Unnamed namespace definition. Its members have potential scope
+// from their point of declaration to the end of the translation
+// unit, and have internal linkage."
+namespace
+{
+
+const auto defaultSizes = "1000000,10000000,100000000";
+const auto histogramBins = 256u;
+
+std::vector<std::size_t> sizes(const std::string & list)
+{
+    auto result = std::vector<std::size_t>();
+    auto stream = std::stringstream(list);
+    auto size = std::string();
+    while (std::getline(stream, size, ','))
+    {
+        const auto value = std::strtoull(size.c_str(), nullptr, 10);
+        if (value > 0)
+            result.push_back(static_cast<std::size_t>(value));
+    }
+    return result;
+}
+
+// Best wall time in milliseconds of the given repetitions of run, each after an untimed prepare.
+double best(const int repetitions, const std::function<void()> & prepare, const std::function<void()> & run)
+{
+    auto result = std::numeric_limits<double>::max();
+    for (auto i = 0; i < repetitions; ++i)
+    {
+        prepare();
+
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        run();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+
+        result = std::min(result, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return result;
+}
+
+void report(const std::string & primitive, const std::size_t elements, const unsigned int threads,
+    const double milliseconds, const double baselineMilliseconds, const bool valid)
+{
+    std::cout << primitive << "," << elements << "," << threads << "," << milliseconds << ","
+        << elements / milliseconds * 1e-3 << "," << baselineMilliseconds << ","
+        << baselineMilliseconds / milliseconds << "," << (valid ? "true" : "false") << std::endl;
+}
+
+}
+
+
+int main(int argc, char ** argv)
+{
+    // [--sizes <n,n,...>] element counts (1M, 10M, and 100M by default), [--threads <n>]
+    // threads of the primitives (0 for hardware concurrency), [--repetitions <n>] runs of
+    // which the fastest is reported, [--seed <n>] of the random keys
+    const auto arguments = cgutils::Arguments(argc, argv);
+
+    const auto threads = static_cast<unsigned int>(std::max(0, arguments.value("threads", 0)));
+    const auto reportedThreads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    const auto repetitions = std::max(1, arguments.value("repetitions", 3));
+    auto generator = std::mt19937_64(static_cast<std::uint64_t>(arguments.value("seed", 1)));
+
+    // the baseline of the sorts is std::sort, of the others a sequential loop
+    std::cout << std::fixed << std::setprecision(3)
+        << "primitive,elements,threads,ms,melements_per_s,baseline_ms,speedup,valid" << std::endl;
+
+    for (const auto count : sizes(arguments.value("sizes", defaultSizes)))
+    {
+        auto keys32 = std::vector<std::uint32_t>(count);
+        auto keys64 = std::vector<std::uint64_t>(count);
+        for (auto i = std::size_t{ 0 }; i < count; ++i)
+        {
+            keys64[i] = generator();
+            keys32[i] = static_cast<std::uint32_t>(keys64[i]);
+        }
+
+        auto sortedKeys32 = std::vector<std::uint32_t>(count);
+        auto sortedKeys64 = std::vector<std::uint64_t>(count);
+        auto values = std::vector<std::uint32_t>(count);
+
+        const auto resetValues = [&values]()
+        {
+            for (auto i = std::size_t{ 0 }; i < values.size(); ++i)
+                values[i] = static_cast<std::uint32_t>(i);
+        };
+
+        // 32-bit keys
+
+        const auto std32 = best(repetitions, [&]() { sortedKeys32 = keys32; },
+            [&]() { std::sort(sortedKeys32.begin(), sortedKeys32.end()); });
+        const auto radix32 = best(repetitions, [&]() { sortedKeys32 = keys32; },
+            [&]() { cgutils::radixSort(sortedKeys32.data(), nullptr, count, threads); });
+        report("radix_sort_32", count, reportedThreads, radix32, std32, std::is_sorted(sortedKeys32.begin(), sortedKeys32.end()));
+
+        // 32-bit keys with indices, against std::sort of key and index packed into 64 bits
+
+        auto packed = std::vector<std::uint64_t>(count);
+        const auto stdPairs32 = best(repetitions,
+            [&]() { for (auto i = std::size_t{ 0 }; i < count; ++i) packed[i] = (std::uint64_t{ keys32[i] } << 32) | i; },
+            [&]() { std::sort(packed.begin(), packed.end()); });
+        const auto radixPairs32 = best(repetitions, [&]() { sortedKeys32 = keys32; resetValues(); },
+            [&]() { cgutils::radixSort(sortedKeys32.data(), values.data(), count, threads); });
+
+        auto valid = true;
+        for (auto i = std::size_t{ 0 }; i < count && valid; ++i)
+            valid = static_cast<std::uint32_t>(packed[i]) == values[i];
+        report("radix_sort_32_pairs", count, reportedThreads, radixPairs32, stdPairs32, valid);
+
+        packed = std::vector<std::uint64_t>();
+
+        // 64-bit keys with indices
+
+        auto pairs = std::vector<std::pair<std::uint64_t, std::uint32_t>>(count);
+        const auto stdPairs64 = best(repetitions,
+            [&]() { for (auto i = std::size_t{ 0 }; i < count; ++i) pairs[i] = std::make_pair(keys64[i], static_cast<std::uint32_t>(i)); },
+            [&]() { std::sort(pairs.begin(), pairs.end()); });
+        const auto radixPairs64 = best(repetitions, [&]() { sortedKeys64 = keys64; resetValues(); },
+            [&]() { cgutils::radixSort(sortedKeys64.data(), values.data(), count, threads); });
+
+        valid = true;
+        for (auto i = std::size_t{ 0 }; i < count && valid; ++i)
+            valid = pairs[i].second == values[i];
+        report("radix_sort_64_pairs", count, reportedThreads, radixPairs64, stdPairs64, valid);
+
+        pairs = std::vector<std::pair<std::uint64_t, std::uint32_t>>();
+
+        // exclusive scan of small values
+
+        auto input = std::vector<std::uint32_t>(count);
+        for (auto i = std::size_t{ 0 }; i < count; ++i)
+            input[i] = keys32[i] & 0xFu;
+
+        auto expected = std::vector<std::uint32_t>(count);
+        auto output = std::vector<std::uint32_t>(count);
+
+        const auto sequentialScan = best(repetitions, []() {}, [&]()
+        {
+            auto carry = std::uint32_t{ 0 };
+            for (auto i = std::size_t{ 0 }; i < count; ++i)
+            {
+                expected[i] = carry;
+                carry += input[i];
+            }
+        });
+        const auto scan = best(repetitions, []() {},
+            [&]() { cgutils::exclusiveScan(input.data(), output.data(), count, threads); });
+        report("exclusive_scan", count, reportedThreads, scan, sequentialScan, output == expected);
+
+        // compaction of half of the elements
+
+        auto flags = std::vector<std::uint8_t>(count);
+        for (auto i = std::size_t{ 0 }; i < count; ++i)
+            flags[i] = static_cast<std::uint8_t>(keys32[i] >> 31);
+
+        auto compacted = std::size_t{ 0 };
+        const auto sequentialCompact = best(repetitions, []() {}, [&]()
+        {
+            compacted = 0;
+            for (auto i = std::size_t{ 0 }; i < count; ++i)
+            {
+                if (flags[i])
+                    expected[compacted++] = static_cast<std::uint32_t>(i);
+            }
+        });
+        auto compactedParallel = std::size_t{ 0 };
+        const auto compact = best(repetitions, []() {},
+            [&]() { compactedParallel = cgutils::compactIndices(flags.data(), output.data(), count, threads); });
+        report("compact_indices", count, reportedThreads, compact, sequentialCompact,
+            compactedParallel == compacted && std::equal(output.begin(), output.begin() + compacted, expected.begin()));
+
+        // histogram of 8-bit values
+
+        for (auto i = std::size_t{ 0 }; i < count; ++i)
+            input[i] = keys32[i] & (histogramBins - 1);
+
+        auto expectedBins = std::vector<std::uint32_t>(histogramBins);
+        auto bins = std::vector<std::uint32_t>(histogramBins);
+
+        const auto sequentialHistogram = best(repetitions, [&]() { std::fill(expectedBins.begin(), expectedBins.end(), 0u); }, [&]()
+        {
+            for (auto i = std::size_t{ 0 }; i < count; ++i)
+                ++expectedBins[input[i]];
+        });
+        const auto parallelHistogram = best(repetitions, []() {},
+            [&]() { cgutils::histogram(input.data(), count, bins.data(), histogramBins, threads); });
+        report("histogram", count, reportedThreads, parallelHistogram, sequentialHistogram, bins == expectedBins);
+    }
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 
+#include <functional>
 #include <iostream>
 
 // C++ library for creating windows with OpenGL contexts and receiving 
@@ -8,8 +9,12 @@
 // C++ binding for the OpenGL API. 
 // https://github.com/cginternals/glbinding
 #include <glbinding/Binding.h>
+#include <glbinding/ContextInfo.h>
 
+#include <cgutils/arguments.h>
+#include <cgutils/benchmark.h>
 #include <cgutils/common.h>
+#include <cgutils/headless.h>
 
 #include "scrat.h"
 
@@ -23,8 +28,14 @@ namespace
 
 auto example = ScrAT();
 
-const auto canvasWidth = 1440; // in pixel
-const auto canvasHeight = 900; // in pixel
+auto canvasWidth = 1440; // in pixel
+auto canvasHeight = 900; // in pixel
+
+const auto defaultHeadlessFrames = 1000;
+
+// batch mode: run the full benchmark matrix and/or quad measurement once and exit
+auto batchMatrix = false;
+auto batchQuads = false;
 
 // "The size callback ... which is called when the window is resized."
 // http://www.glfw.org/docs/latest/group__window.html#gaa40cd24840daa8c62f36cafc847c72b6
@@ -54,6 +65,14 @@ void keyCallback(GLFWwindow * /*window*/, int key, int /*scancode*/, int action,
         example.switchVAO();
         break;
 
+    case GLFW_KEY_M:
+        example.benchmarkMatrix();
+        break;
+
+    case GLFW_KEY_Q:
+        example.measureQuadOvershading();
+        break;
+
     case GLFW_KEY_T:
         mods == GLFW_MOD_SHIFT ? example.incrementReplaySpeed() : example.decrementReplaySpeed();
         break;
@@ -70,11 +89,90 @@ void errorCallback(int errnum, const char * errmsg)
 }
 
 
+void runBatch()
+{
+    if (batchQuads)
+        example.measureQuadOvershading();
+    if (batchMatrix)
+        example.benchmarkMatrix();
+}
+
+// Renders and measures "--frames" frames after "--warmup" frames and writes the 
+// configuration and frame times as JSON to "--output" (stdout by default) and 
+// appends it to the results store "--store" (see benchmark_compare).
+void runBenchmark(const cgutils::Arguments & arguments, const int frames, const std::function<void()> & swap)
+{
+    auto result = cgutils::BenchmarkResult();
+
+    result.set("example", "screen_aligned_triangles");
+    result.set("vao-mode", example.vaoMode());
+    result.set("width", canvasWidth);
+    result.set("height", canvasHeight);
+    result.set("headless", arguments.value("headless", false));
+    result.set("renderer", glbinding::ContextInfo::renderer());
+    result.setEnvironment();
+
+    cgutils::measureFrames(result, frames, arguments.value("warmup", 0), [&swap]()
+    {
+        example.render();
+        swap();
+        gl::glFinish();
+    });
+
+    result.write(arguments.value("output", "-"));
+
+    const auto store = arguments.value("store", "benchmarks.jsonl");
+    if (!store.empty())
+        result.append(store);
+}
+
+// Renders a fixed number of frames into an offscreen pbuffer surface, i.e., 
+// without any window or display server.
+int runHeadless(const cgutils::Arguments & arguments)
+{
+    auto context = cgutils::HeadlessContext();
+    if (!context.create(canvasWidth, canvasHeight, 4, 2))
+        return 3;
+
+    glbinding::Binding::initialize(false);
+
+    example.resize(canvasWidth, canvasHeight);
+    example.initialize();
+    example.setVAOMode(arguments.value("vao-mode", example.vaoMode()));
+
+    runBatch();
+
+    const auto batch = batchMatrix || batchQuads;
+    const auto frames = arguments.value("frames", batch ? 0 : defaultHeadlessFrames);
+    if (frames > 0)
+        runBenchmark(arguments, frames, [&context]() { context.swapBuffers(); });
+
+    example.cleanup();
+    context.destroy();
+
+    return 0;
+}
+
 }
 
 
-int main(int /*argc*/, char ** /*argv*/)
+int main(int argc, char ** argv)
 {
+    // [--headless] render offscreen without any window, [--frames <n>] benchmark n frames and exit,
+    // [--matrix] and [--quads] run the respective measurement once, [--config <file>] read options from file
+    const auto arguments = cgutils::Arguments(argc, argv);
+
+    canvasWidth = arguments.value("width", canvasWidth);
+    canvasHeight = arguments.value("height", canvasHeight);
+
+    batchMatrix = arguments.value("matrix", false);
+    batchQuads = arguments.value("quads", false);
+
+    const auto batch = batchMatrix || batchQuads;
+
+    if (arguments.value("headless", false))
+        return runHeadless(arguments);
+
     if (!glfwInit())
     {
         return 1;
@@ -105,6 +203,8 @@ int main(int /*argc*/, char ** /*argv*/)
         << "  [F5] reload shaders" << std::endl
         << "  [r]  reset record and benchmark and record anew" << std::endl
         << "  [v]  switch draw mode and associated vertex array" << std::endl
+        << "  [m]  benchmark all draw modes over resolutions and sample counts (csv)" << std::endl
+        << "  [q]  measure launched quads and helper invocations per draw mode (csv)" << std::endl
         << "  [T]  increment replay speed (by magnitude)" << std::endl
         << "  [t]  decrement replay speed (by magnitude)" << std::endl
         << std::endl;
@@ -115,6 +215,19 @@ int main(int /*argc*/, char ** /*argv*/)
 
     example.resize(canvasWidth, canvasHeight);
     example.initialize();
+    example.setVAOMode(arguments.value("vao-mode", example.vaoMode()));
+
+    runBatch();
+    if (arguments.has("frames"))
+    {
+        runBenchmark(arguments, arguments.value("frames", 0), [window]()
+        {
+            glfwPollEvents();
+            glfwSwapBuffers(window);
+        });
+    }
+    if (batch || arguments.has("frames"))
+        glfwSetWindowShouldClose(window, true);
 
     while (!glfwWindowShouldClose(window)) // main loop
     {
@@ -1,11 +1,17 @@
 
 #include "scrat.h"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <iomanip>
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <glbinding/gl32ext/gl.h>
+#include <glbinding/ContextInfo.h>
 
 #include <cgutils/common.h>
 
@@ -13,8 +19,105 @@
 using namespace gl32core;
 
 
+namespace
+{
+
+const auto modeLabels = std::array<std::string, 5>{
+    "two-triangles",
+    "strip-quad",
+    "single-triangle",
+    "fill-rectangle-nv",
+    "attributeless-gs-triangle" };
+
+
+struct QuadCoverage
+{
+    std::uint64_t fragments;
+    std::uint64_t quads;
+};
+
+// Emulates which 2x2 quads a rasterizer launches for the given triangles (NDC, counter-
+// clockwise or clockwise) using pixel center sampling and the top-left fill convention.
+// Quads are launched per triangle, thus quads along shared edges are counted twice.
+QuadCoverage emulateQuadCoverage(const std::vector<std::array<float, 6>> & triangles, const int width, const int height)
+{
+    auto coverage = QuadCoverage{ 0u, 0u };
+
+    for (const auto & triangle : triangles)
+    {
+        // transform to window coordinates
+        auto v = std::array<float, 6>{};
+        for (auto i = 0; i < 3; ++i)
+        {
+            v[i * 2 + 0] = (triangle[i * 2 + 0] * 0.5f + 0.5f) * width;
+            v[i * 2 + 1] = (triangle[i * 2 + 1] * 0.5f + 0.5f) * height;
+        }
+
+        // enforce counter-clockwise orientation
+        const auto area = (v[2] - v[0]) * (v[5] - v[1]) - (v[3] - v[1]) * (v[4] - v[0]);
+        if (area == 0.f)
+            continue;
+        if (area < 0.f)
+        {
+            std::swap(v[2], v[4]);
+            std::swap(v[3], v[5]);
+        }
+
+        const auto edge = [&v](const int a, const int b, const float x, const float y)
+        {
+            return (v[b * 2] - v[a * 2]) * (y - v[a * 2 + 1]) - (v[b * 2 + 1] - v[a * 2 + 1]) * (x - v[a * 2]);
+        };
+        const auto topLeft = [&v](const int a, const int b)
+        {
+            const auto dx = v[b * 2] - v[a * 2];
+            const auto dy = v[b * 2 + 1] - v[a * 2 + 1];
+            return (dy == 0.f && dx < 0.f) || dy < 0.f;
+        };
+        const auto inside = [&](const float x, const float y)
+        {
+            static const auto edges = std::array<std::pair<int, int>, 3>{ { { 0, 1 }, { 1, 2 }, { 2, 0 } } };
+            for (const auto & e : edges)
+            {
+                const auto w = edge(e.first, e.second, x, y);
+                if (w < 0.f || (w == 0.f && !topLeft(e.first, e.second)))
+                    return false;
+            }
+            return true;
+        };
+
+        // quad aligned bounding box, clipped to the viewport
+        const auto x0 = std::max(0, static_cast<int>(std::floor(std::min({ v[0], v[2], v[4] }))) & ~1);
+        const auto y0 = std::max(0, static_cast<int>(std::floor(std::min({ v[1], v[3], v[5] }))) & ~1);
+        const auto x1 = std::min(width,  static_cast<int>(std::ceil(std::max({ v[0], v[2], v[4] }))));
+        const auto y1 = std::min(height, static_cast<int>(std::ceil(std::max({ v[1], v[3], v[5] }))));
+
+        for (auto y = y0; y < y1; y += 2)
+            for (auto x = x0; x < x1; x += 2)
+            {
+                auto covered = 0u;
+                for (auto i = 0; i < 4; ++i)
+                {
+                    const auto px = x + (i & 1);
+                    const auto py = y + (i >> 1);
+                    if (px < width && py < height && inside(px + 0.5f, py + 0.5f))
+                        ++covered;
+                }
+
+                coverage.fragments += covered;
+                coverage.quads += covered > 0 ? 1 : 0;
+            }
+    }
+
+    return coverage;
+}
+
+}
+
+
 ScrAT::ScrAT()
-: m_recorded(false)
+: m_fillRectangleAvailable(false)
+, m_quadProgramsAvailable(false)
+, m_recorded(false)
 , m_vaoMode(0)
 , m_timeDurationMagnitude(3u)
 {
@@ -37,11 +140,14 @@ ScrAT::~ScrAT()
     glDeleteTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
 
     glDeleteBuffers(1, &m_acbuffer);
+    glDeleteBuffers(1, &m_quadCounterBuffer);
     glDeleteQueries(1, &m_query);
 }
 
 void ScrAT::initialize()
 {
+    m_fillRectangleAvailable = glbinding::ContextInfo::supported({ GLextension::GL_NV_fill_rectangle });
+
     glClearColor(0.12f, 0.14f, 0.18f, 1.0f);
 
     glGenBuffers(2, m_vbos.data());
@@ -97,6 +203,24 @@ void ScrAT::initialize()
         glBindFragDataLocation(m_programs[2], 0, "out_color");
     }
 
+    // quad overshading measurement programs
+    {
+        m_programs[3] = glCreateProgram();
+        m_programs[4] = glCreateProgram();
+
+        m_fragmentShaders[2] = glCreateShader(GL_FRAGMENT_SHADER);
+
+        glAttachShader(m_programs[3], m_vertexShaders[0]);
+        glAttachShader(m_programs[3], m_fragmentShaders[2]);
+
+        glAttachShader(m_programs[4], m_vertexShaders[2]);
+        glAttachShader(m_programs[4], m_geometryShaders[0]);
+        glAttachShader(m_programs[4], m_fragmentShaders[2]);
+
+        glBindFragDataLocation(m_programs[3], 0, "out_color");
+        glBindFragDataLocation(m_programs[4], 0, "out_color");
+    }
+
     loadShaders();
 
 
@@ -134,6 +258,11 @@ void ScrAT::initialize()
     glBufferData(gl32ext::GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
     glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0);
 
+    glGenBuffers(1, &m_quadCounterBuffer);
+    glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, m_quadCounterBuffer);
+    glBufferData(gl32ext::GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint) * 3, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0);
+
     // setup time measurement
 
     glGenQueries(1, &m_query);
@@ -145,13 +274,14 @@ void ScrAT::cleanup()
 
 bool ScrAT::loadShaders()
 {
-    static const auto sourceFiles = std::array<std::string, 6>{
+    static const auto sourceFiles = std::array<std::string, 7>{
         "data/screen_aligned_triangles/record.vert",
         "data/screen_aligned_triangles/record-empty.vert",
         "data/screen_aligned_triangles/record.geom",
         "data/screen_aligned_triangles/record.frag",
         "data/screen_aligned_triangles/replay.vert",
-        "data/screen_aligned_triangles/replay.frag"  };
+        "data/screen_aligned_triangles/replay.frag",
+        "data/screen_aligned_triangles/quads.frag" };
 
     {
         const auto vertexShaderSource = cgutils::textFromFile(sourceFiles[0].c_str());
@@ -246,6 +376,26 @@ bool ScrAT::loadShaders()
             return false;
     }
 
+    // the quad overshading measurement requires GLSL 4.50 (gl_HelperInvocation) and is optional
+    {
+        const auto fragmentShaderSource = cgutils::textFromFile(sourceFiles[6].c_str());
+        const auto fragmentShaderSource_ptr = fragmentShaderSource.c_str();
+        if (fragmentShaderSource_ptr)
+            glShaderSource(m_fragmentShaders[2], 1, &fragmentShaderSource_ptr, 0);
+
+        glCompileShader(m_fragmentShaders[2]);
+        m_quadProgramsAvailable = cgutils::checkForCompilationError(m_fragmentShaders[2], sourceFiles[6]);
+
+        if (m_quadProgramsAvailable)
+        {
+            gl::glLinkProgram(m_programs[3]);
+            m_quadProgramsAvailable &= cgutils::checkForLinkerError(m_programs[3], "quads program");
+
+            gl::glLinkProgram(m_programs[4]);
+            m_quadProgramsAvailable &= cgutils::checkForLinkerError(m_programs[4], "quads (geometry) program");
+        }
+    }
+
 
     loadUniformLocations();
 
@@ -296,41 +446,12 @@ void ScrAT::resize(int w, int h)
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-std::uint64_t ScrAT::record(const bool benchmark)
+void ScrAT::draw(const int vaoMode, const bool benchmark)
 {
-    glViewport(0, 0, m_width, m_height);
-
-    // clear record buffer
-
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    static const GLfloat color[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    glClearBufferfv(GL_COLOR, 0, color);
-
-    // reset atomic counter
-
-    glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, m_acbuffer);
-
-    //auto counter = static_cast<GLuint *>(glMapBufferRange(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint),
-    //    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
-    //memset(counter, 0, sizeof(GLuint));
-    //glUnmapBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER);
-
-    const auto counter = 0u;
-    glBufferSubData(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &counter);
-    glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0);
-
-    glBindBufferBase(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, m_acbuffer);
-    
-    // draw
-
-    auto elapsed = std::uint64_t{ 0 };
-
-    if (m_vaoMode == 4)
+    if (vaoMode == 4)
     {
         glUseProgram(m_programs[2]);
-        glUniform1i(m_uniformLocations[4], static_cast<GLint>(benchmark));
+        glUniform1i(m_uniformLocations[3], static_cast<GLint>(benchmark));
     }
     else
     {
@@ -338,10 +459,12 @@ std::uint64_t ScrAT::record(const bool benchmark)
         glUniform1i(m_uniformLocations[2], static_cast<GLint>(benchmark));
     }
 
-    if(benchmark)
-        glBeginQuery(gl::GL_TIME_ELAPSED, m_query);
+    drawVariant(vaoMode);
+}
 
-    switch(m_vaoMode)
+void ScrAT::drawVariant(const int vaoMode)
+{
+    switch(vaoMode)
     {
     case 0:
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -371,6 +494,45 @@ std::uint64_t ScrAT::record(const bool benchmark)
         break;
     }
 
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+}
+
+std::uint64_t ScrAT::record(const bool benchmark)
+{
+    glViewport(0, 0, m_width, m_height);
+
+    // clear record buffer
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    static const GLfloat color[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, color);
+
+    // reset atomic counter
+
+    glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, m_acbuffer);
+
+    //auto counter = static_cast<GLuint *>(glMapBufferRange(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint),
+    //    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    //memset(counter, 0, sizeof(GLuint));
+    //glUnmapBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER);
+
+    const auto counter = 0u;
+    glBufferSubData(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &counter);
+    glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0);
+
+    glBindBufferBase(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, m_acbuffer);
+    
+    // draw
+
+    auto elapsed = std::uint64_t{ 0 };
+
+    if(benchmark)
+        glBeginQuery(gl::GL_TIME_ELAPSED, m_query);
+
+    draw(m_vaoMode, benchmark);
+
     if (benchmark)
     {
         glEndQuery(gl::GL_TIME_ELAPSED);       
@@ -485,6 +647,20 @@ void ScrAT::switchVAO()
     m_vaoMode = (++m_vaoMode) % 5;
 }
 
+int ScrAT::vaoMode() const
+{
+    return m_vaoMode;
+}
+
+void ScrAT::setVAOMode(const int mode)
+{
+    if (mode < 0 || mode > 4 || mode == m_vaoMode)
+        return;
+
+    m_recorded = false;
+    m_vaoMode = mode;
+}
+
 void ScrAT::incrementReplaySpeed()
 {
     updateThreshold();
@@ -507,3 +683,168 @@ void ScrAT::decrementReplaySpeed()
 
     --m_timeDurationMagnitude;
 }
+
+void ScrAT::benchmarkMatrix()
+{
+    // offscreen targets from 720p up to 8K, each rendered with and without multisampling
+    static const auto resolutions = std::array<std::pair<int, int>, 6>{ {
+        { 1280,  720 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 }, { 5120, 2880 }, { 7680, 4320 } } };
+    static const auto sampleCounts = std::array<int, 4>{ 0, 2, 4, 8 };
+
+    static const auto warmupIterations = 10;
+    static const auto iterations = 100;
+
+    auto maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    auto maxRenderbufferSize = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbufferSize);
+
+    auto fbo = GLuint{ 0 };
+    auto renderbuffer = GLuint{ 0 };
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &renderbuffer);
+
+    glBindBufferBase(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, m_acbuffer);
+
+    std::cout << "mode,width,height,samples,iterations,ns_per_draw,ns_per_pixel" << std::endl;
+
+    for (const auto & resolution : resolutions)
+    {
+        const auto width = resolution.first;
+        const auto height = resolution.second;
+
+        if (width > maxRenderbufferSize || height > maxRenderbufferSize)
+        {
+            std::cerr << "skipped " << width << "x" << height << ": exceeds max renderbuffer size" << std::endl;
+            continue;
+        }
+
+        for (const auto samples : sampleCounts)
+        {
+            if (samples > maxSamples)
+                continue;
+
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_R32F, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+
+            // large multisampled targets might not fit into video memory
+            if (glGetError() != GL_NO_ERROR
+                || glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            {
+                std::cerr << "skipped " << width << "x" << height << "@" << samples
+                    << ": render target not available" << std::endl;
+                continue;
+            }
+
+            glViewport(0, 0, width, height);
+
+            for (auto mode = 0; mode < static_cast<int>(modeLabels.size()); ++mode)
+            {
+                if (mode == 3 && !m_fillRectangleAvailable)
+                    continue;
+
+                for (auto i = 0; i < warmupIterations; ++i)
+                    draw(mode, true);
+
+                glFinish();
+
+                glBeginQuery(gl::GL_TIME_ELAPSED, m_query);
+                for (auto i = 0; i < iterations; ++i)
+                    draw(mode, true);
+                glEndQuery(gl::GL_TIME_ELAPSED);
+
+                auto elapsed = std::uint64_t{ 0 };
+                glGetQueryObjectui64v(m_query, GL_QUERY_RESULT, &elapsed); // blocks until available
+
+                const auto nsPerDraw = static_cast<double>(elapsed) / iterations;
+                const auto nsPerPixel = nsPerDraw / (static_cast<double>(width) * height);
+
+                std::cout << modeLabels[mode] << "," << width << "," << height << "," << samples << ","
+                    << iterations << "," << std::fixed << std::setprecision(1) << nsPerDraw << ","
+                    << std::setprecision(6) << nsPerPixel << std::defaultfloat << std::endl;
+            }
+        }
+    }
+
+    glBindBufferBase(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, 0);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glDeleteRenderbuffers(1, &renderbuffer);
+    glDeleteFramebuffers(1, &fbo);
+
+    // restore viewport and record buffer for interactive replay
+    glViewport(0, 0, m_width, m_height);
+    m_recorded = false;
+}
+
+void ScrAT::measureQuadOvershading()
+{
+    // triangles per draw variant in NDC (the fill rectangle variant covers the bounding rectangle)
+    static const auto triangles = std::array<std::vector<std::array<float, 6>>, 5>{ {
+        { { -1.f, -1.f, -1.f, 1.f, 1.f, -1.f }, { -1.f, 1.f, 1.f, -1.f, 1.f, 1.f } },
+        { { -1.f, -1.f, -1.f, 1.f, 1.f, -1.f }, { 1.f, -1.f, -1.f, 1.f, 1.f, 1.f } },
+        { { -1.f, -3.f, -1.f, 1.f, 3.f, 1.f } },
+        { { -1.f, -1.f, -1.f, 1.f, 1.f, -1.f }, { -1.f, -1.f, 1.f, 1.f, 1.f, -1.f } },
+        { { 1.f, -1.f, 1.f, 3.f, -3.f, -1.f } } } };
+
+    std::cout << "mode,width,height,source,fragments,quads,helpers,wasted_percent" << std::endl;
+
+    const auto report = [this](const int mode, const char * source
+        , const std::uint64_t fragments, const std::uint64_t quads, const std::uint64_t helpers)
+    {
+        const auto wasted = quads > 0 ? 100.0 * static_cast<double>(helpers) / (4.0 * quads) : 0.0;
+        std::cout << modeLabels[mode] << "," << m_width << "," << m_height << "," << source << ","
+            << fragments << "," << quads << "," << helpers << ","
+            << std::fixed << std::setprecision(3) << wasted << std::defaultfloat << std::endl;
+    };
+
+    if (!m_quadProgramsAvailable)
+        std::cerr << "quad measurement on gpu skipped: requires GLSL 4.50" << std::endl;
+
+    for (auto mode = 0; mode < static_cast<int>(modeLabels.size()); ++mode)
+    {
+        if (m_quadProgramsAvailable && (mode != 3 || m_fillRectangleAvailable))
+        {
+            glViewport(0, 0, m_width, m_height);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+            static const std::array<GLuint, 3> zeros = { 0u, 0u, 0u };
+            glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, m_quadCounterBuffer);
+            glBufferSubData(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint) * 3, zeros.data());
+            glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0);
+
+            glBindBufferBase(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, m_quadCounterBuffer);
+
+            glUseProgram(m_programs[mode == 4 ? 4 : 3]);
+            drawVariant(mode);
+
+            glBindVertexArray(0);
+            glUseProgram(0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glBindBufferBase(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, 0);
+
+            auto counters = std::array<GLuint, 3>{};
+            gl32ext::glMemoryBarrier(gl32ext::GL_ATOMIC_COUNTER_BARRIER_BIT);
+            glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, m_quadCounterBuffer);
+            glGetBufferSubData(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint) * 3, counters.data());
+            glBindBuffer(gl32ext::GL_ATOMIC_COUNTER_BUFFER, 0);
+
+            report(mode, "gpu", counters[0], counters[1], counters[2]);
+        }
+
+        // cpu emulation as reference (the fill rectangle variant launches whole quads only)
+        auto coverage = QuadCoverage{ static_cast<std::uint64_t>(m_width) * m_height
+            , static_cast<std::uint64_t>((m_width + 1) / 2) * ((m_height + 1) / 2) };
+        if (mode != 3)
+            coverage = emulateQuadCoverage(triangles[mode], m_width, m_height);
+
+        report(mode, "emulated", coverage.fragments, coverage.quads, coverage.quads * 4 - coverage.fragments);
+    }
+}
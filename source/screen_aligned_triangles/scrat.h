@@ -25,12 +25,20 @@ public:
     void resetAC();
     void switchVAO();
 
+    int vaoMode() const;
+    void setVAOMode(int mode);
+
+    void benchmarkMatrix();
+    void measureQuadOvershading();
+
     void incrementReplaySpeed();
     void decrementReplaySpeed();
 
 protected:
     void loadUniformLocations();
 
+    void draw(int vaoMode, bool benchmark);
+    void drawVariant(int vaoMode);
     std::uint64_t record(bool benchmark);
     void replay();
 
@@ -39,10 +47,10 @@ protected:
 protected:
     std::array<gl::GLuint, 2> m_vbos;
 
-    std::array<gl::GLuint, 3> m_programs;
+    std::array<gl::GLuint, 5> m_programs;
     std::array<gl::GLuint, 3> m_vertexShaders;
     std::array<gl::GLuint, 2> m_geometryShaders;
-    std::array<gl::GLuint, 2> m_fragmentShaders;
+    std::array<gl::GLuint, 3> m_fragmentShaders;
 
     std::array<gl::GLuint, 3> m_vaos;
     gl::GLuint m_fbo;
@@ -51,6 +59,10 @@ protected:
 
     gl::GLuint m_query;
     gl::GLuint m_acbuffer;   
+    gl::GLuint m_quadCounterBuffer; // { fragments, quads, helpers }
+
+    bool m_fillRectangleAvailable;
+    bool m_quadProgramsAvailable;
 
     bool m_recorded;
     std::array<float, 3> m_threshold; // { last, current, max }
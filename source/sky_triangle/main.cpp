@@ -1,4 +1,5 @@
 
+#include <functional>
 #include <iostream>
 
 // C++ library for creating windows with OpenGL contexts and receiving 
@@ -8,8 +9,12 @@
 // C++ binding for the OpenGL API. 
 // https://github.com/cginternals/glbinding
 #include <glbinding/Binding.h>
+#include <glbinding/ContextInfo.h>
 
+#include <cgutils/arguments.h>
+#include <cgutils/benchmark.h>
 #include <cgutils/common.h>
+#include <cgutils/headless.h>
 
 #include "skytriangle.h"
 
@@ -23,8 +28,10 @@ namespace
 
 auto example = SkyTriangle();
 
-const auto canvasWidth = 1440; // in pixel
-const auto canvasHeight = 900; // in pixel
+auto canvasWidth = 1440; // in pixel
+auto canvasHeight = 900; // in pixel
+
+const auto defaultHeadlessFrames = 1000;
 
 // "The size callback ... which is called when the window is resized."
 // http://www.glfw.org/docs/latest/group__window.html#gaa40cd24840daa8c62f36cafc847c72b6
@@ -58,11 +65,70 @@ void errorCallback(int errnum, const char * errmsg)
 }
 
 
+// Renders and measures "--frames" frames after "--warmup" frames and writes the 
+// configuration and frame times as JSON to "--output" (stdout by default) and 
+// appends it to the results store "--store" (see benchmark_compare).
+void runBenchmark(const cgutils::Arguments & arguments, const int frames, const std::function<void()> & swap)
+{
+    auto result = cgutils::BenchmarkResult();
+
+    result.set("example", "sky_triangle");
+    result.set("width", canvasWidth);
+    result.set("height", canvasHeight);
+    result.set("headless", arguments.value("headless", false));
+    result.set("renderer", glbinding::ContextInfo::renderer());
+    result.setEnvironment();
+
+    cgutils::measureFrames(result, frames, arguments.value("warmup", 0), [&swap]()
+    {
+        example.render();
+        swap();
+        gl::glFinish();
+    });
+
+    result.write(arguments.value("output", "-"));
+
+    const auto store = arguments.value("store", "benchmarks.jsonl");
+    if (!store.empty())
+        result.append(store);
+}
+
+// Renders a fixed number of frames into an offscreen pbuffer surface, i.e., 
+// without any window or display server.
+int runHeadless(const cgutils::Arguments & arguments)
+{
+    auto context = cgutils::HeadlessContext();
+    if (!context.create(canvasWidth, canvasHeight, 4, 1))
+        return 3;
+
+    glbinding::Binding::initialize(false);
+
+    example.resize(canvasWidth, canvasHeight);
+    example.initialize();
+
+    runBenchmark(arguments, arguments.value("frames", defaultHeadlessFrames), [&context]() { context.swapBuffers(); });
+
+    example.cleanup();
+    context.destroy();
+
+    return 0;
+}
+
 }
 
 
-int main(int /*argc*/, char ** /*argv*/)
+int main(int argc, char ** argv)
 {
+    // [--headless] render offscreen without any window, [--frames <n>] benchmark n frames and exit,
+    // [--width/--height <n>] canvas size, [--config <file>] read options from file
+    const auto arguments = cgutils::Arguments(argc, argv);
+
+    canvasWidth = arguments.value("width", canvasWidth);
+    canvasHeight = arguments.value("height", canvasHeight);
+
+    if (arguments.value("headless", false))
+        return runHeadless(arguments);
+
     if (!glfwInit())
     {
         return 1;
@@ -102,6 +168,16 @@ int main(int /*argc*/, char ** /*argv*/)
     example.resize(width, height);
     example.initialize();
 
+    if (arguments.has("frames"))
+    {
+        runBenchmark(arguments, arguments.value("frames", 0), [window]()
+        {
+            glfwPollEvents();
+            glfwSwapBuffers(window);
+        });
+        glfwSetWindowShouldClose(window, true);
+    }
+
     while (!glfwWindowShouldClose(window)) // main loop
     {
         glfwPollEvents();